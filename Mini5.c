@@ -69,6 +69,12 @@
 //140: Attenuator setting
 //142: Tone set
 
+//Bytes 0..142 are read only once to migrate old settings into the config block:
+//Byte 160..228: Config block (struct config), version and CRC protected
+//Byte 64..132: Copy B of config block, written after copy A (replaces old data after migration)
+//Byte 256..507: Operating state log
+//Byte 512..1023: 128 memory channels with 4 bytes each
+
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -79,21 +85,46 @@
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
 #include <avr/eeprom.h>
+#include <util/crc16.h>
 #include <util/delay.h>
 #include <avr/pgmspace.h>
 
+#ifndef pgm_read_ptr //avr-libc older than 1.8.1
+#define pgm_read_ptr(p) (void*) pgm_read_word(p)
+#endif
+
 #define OFF_LAST_BAND_USED 0
 #define OFF_LAST_VFO_USED 5
 #define OFF_LAST_SIDEBAND_USED 6
 #define OFF_VFO_DATA 7
 #define OFF_FREQ_DATA 64
+#define OFF_CONFIG 160
+#define OFF_CONFIG_B 64
+#define CONFIG_VERSION 1
+
+//Operating state log: 42 slots of 6 bytes used round robin in 256..507
+//Byte 0: sequence number 0..14 << 4 | field mask, byte 1: band | VFO << 3 | sideband << 4
+//Byte 2..4: frequency - band_f0[band] MSB first, byte 5: checksum
+//Only fields that changed (mask bit 0..3 = byte 1..4) are written, the other
+//bytes of the slot are left alone. Every LOG_FULL-th record has all fields.
+#define OFF_STATE_LOG 256
+#define LOG_REC 6
+#define LOG_SLOTS 42 //Must not be a multiple of LOG_SEQ
+#define LOG_SEQ 15   //Sequence 15 is erased EEPROM
+#define LOG_FULL 8
+
+//Memory channels: 4 bytes MSB first, 0xFFFFFFFF = empty
+//Bit 31..29: band, 28..9: frequency - band_f0[band], 3: sideband, 2: ATT, 1: AGC, 0: TONE
+//so that channels sort by band and frequency when compared as unsigned long
+#define OFF_MEM 512
+#define MEM_CHANNELS 128
 
 //Modes and Bands
 #define MAXMODES 2
 #define MAXBANDS 5
 
 //MENU
-#define MENUSTRINGS 9
+#define MENUSTRINGS 12
 #define MENUITEMS 5
 
 //Interfrequency options
@@ -185,13 +216,34 @@ long band_f1[] = {3800000, 7200000, 14350000, 18165000, 21465000};  //Edge frequ
 int cur_band;
 
 //STRING HANDLING
-char *oldbuf;
+//Powers of ten for the number renderer
+const long pow10_tab[10] PROGMEM = {1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
 
 //S-Meter
-int smax = 0;
-
-//Menu
-int menu_items[MENUSTRINGS] =  {4, 1, 1, 1, 1, 2, 1, 1, 4}; 
+int smax = 0; //Position of peak marker on bar graph
+
+//S-Meter filter stage, fed by ADC IRQ with every ADC1 sample (~9.6kHz)
+//Levels are (ADC - SMETER_OFFSET) in Q5 fixed point
+#define SMETER_OFFSET 300
+#define SMETER_ATTACK 2  //Fast attack: tau = 4 samples (0.4ms)
+#define SMETER_DECAY 7   //Slow decay: tau = 128 ticks of 32 samples (0.4s)
+#define SMETER_HOLD 600  //Peak hold: 600 ticks of 32 samples (2s), then decay
+volatile unsigned int smeter_avg = 0;
+volatile unsigned int smeter_peak = 0;
+unsigned int smeter_hold = 0;
+uint8_t smeter_div = 0;
+
+//Noise floor per band in dB over S0 * 16 from scan samples, -1 = no estimate yet
+//Running 10th percentile: +1/16dB for samples above, -9/16dB for samples below
+//Scans stop at noise floor + thresh and keep open down to SQ_HYST less
+#define NF_UP 1
+#define NF_DOWN 9
+#define SQ_HYST 3
+int noise_floor[MAXBANDS] = {-1, -1, -1, -1, -1};
+
+//dB over S0 for (ADC - SMETER_OFFSET) = 0, 8, 16...128, linear interpolation in between
+//S9 = 54dB (6dB per S unit), calibrated to the bar graph scale S1..9, +10, +20dB
+const uint8_t smeter_db_tab[17] PROGMEM = {0, 7, 13, 20, 27, 33, 40, 47, 53, 57, 60, 64, 67, 70, 74, 77, 80};
 
 //TX amplifier preset values
 int tx_preset[6] = {0, 0, 0, 0, 0, 0};
@@ -213,6 +265,14 @@ int agc = 0;
 
 //TONE (audio)
 int cur_tone = 0;
+
+//TX/RX indicator
+int txrx = 0;
+
+//RIT/XIT offsets in Hz
+#define RITMAX 9990
+int rit = 0;
+int xit = 0;
 	
 /////////////////////
 //Defines for Si5351
@@ -239,11 +299,20 @@ int cur_tone = 0;
 void si5351_write(int, int);
 void si5351_start(void);
 void si5351_set_freq(int, long);
+void si5351_calc_regs(long, uint8_t*);
+void si5351_write_regs(int, uint8_t*);
+
+//Last register images written to multisynth 0..2 
+uint8_t si5351_shadow[3][8];
+
+//Precomputed VFO register images: [0] RX (f + rit), [1] TX (f + xit)
+uint8_t vfo_regs[2][8];
 
 ////////////////
 // TRX Control
 ///////////////
 void set_band(int);
+void band_relays(int);
 
 #undef F_CPU 
 #define F_CPU 16000000
@@ -458,12 +527,46 @@ unsigned int backcolor;
 //Radio
 void set_vfo(long);
 void set_lo(int);
-long set_lo_frequencies(int);
+int if_level(long, long);
+void if_sweep(void);
+#define IF_SPAN 6000  //Hz, LO sweep around IF_CENTER
+#define IF_POINTS 60  //2 pixels per point
+#define IF_AVG 4      //S-Meter samples per point
+long if_edge(long, long, long, int);
+void if_autolo(void);
+#define IF_RES 10          //Hz, resolution of edge search
+#define IF_CARRIER_OFS 300 //Hz outside -6dB edge if -20dB edge is beyond sweep span
 int calc_tuningfactor(void);
+unsigned int get_ms(void);
 int get_adc(int);
 int get_pa_temp(void);
+int get_voltage(void);
+int get_tx_power(void);
+int tx_power2px(int);
+int sensor_lookup(const int*, int);
+
+//Sensor curves, 33 points for ADC = 0, 32, 64...1024
+//PA temp. sensor with 1k to 5V: R = 1000 * ADC / (1023 - ADC), T = (R - 815) / 8.81
+//degrees C * 16, clipped at 1000 degrees
+const int pa_temp_tab[33] PROGMEM = {-1480, -1421, -1359, -1292, -1220, -1143, -1061, -971, 
+	                                 -874, -769, -653, -527, -389, -235, -65, 125, 
+	                                 340, 582, 860, 1181, 1555, 1997, 2528, 3177, 
+	                                 3990, 5035, 6431, 8389, 11333, 16000, 16000, 16000, 16000};
+
+//TX power in 0.1W, P ~ U^2 from RF detector, 10W at ADC2 = 960
+const int tx_pwr_tab[33] PROGMEM = {0, 0, 0, 1, 2, 3, 4, 5, 
+	                                7, 9, 11, 13, 16, 19, 22, 25, 
+	                                28, 32, 36, 40, 44, 49, 54, 59, 
+	                                64, 69, 75, 81, 87, 93, 100, 107, 114};
 int is_band_freq(long, int);
 int get_s_value(void);
+int get_s_peak(void);
+void smeter_reset(void);
+void noise_update(int);
+int squelch_level(void);
+int refine_level(void);
+int smeter_db(unsigned int);
+int smeter_db2px(int);
 long tune_frequency(long);
 void set_att(int);
 void set_agc(int);
@@ -471,7 +574,6 @@ void set_tone(int);
 
 //MISC
 void e_save(void);
-void tune(void);
 
 //IC
 void twi_init(void);
@@ -479,61 +581,283 @@ void twi_start(void);
 void twi_stop(void);
 void twi_write(uint8_t u8data);
 
-//String
-int int2asc(long num, int dec, char *buf, int buflen);
-
 //Data display functions
 void show_all_data(long, int, int, int, int, int, int);
 void show_frequency1(long, int);
 void show_frequency2(long);
 void show_sideband(int, int);
 void show_voltage(int);
-void store_vfo(int, int);
 void show_band(int, int);
 void show_tone(int);
 void show_vfo(int, int);
 void show_split(int, int);
 void show_pa_temp(void);
-void show_msg(char*);
+void show_msg_P(const char*);
 void show_meter(int);
+void show_smeter(void);
+void draw_meter_segment(int, int);
 void draw_meter_scale(int meter_type);
 void draw_meter_bar(int, int, int);
-void clear_smax(void);
 void show_att(int);
 void show_agc(int);
+void show_ritxit(void);
+
+//Display strings in flash
+const char blank_str[] PROGMEM = "                "; //One row
+const char band_str[MAXBANDS][4] PROGMEM = {"80m", "40m", "20m", "17m", "15m"};
+const char sb_str[MAXMODES + 1][4] PROGMEM = {"LSB", "USB"};
+const char vfo_str[2][5] PROGMEM = {"VFOA", "VFOB"};
+const char ritxit_str[2][11] PROGMEM = {"RIT ADJUST", "XIT ADJUST"};
 
 //EEPROM
+//Write-behind cache: ee_write_byte() queues address and value, EE_READY_vect
+//writes one byte per interrupt (3.4ms) so IRQs and encoder keep running
+#define EE_QUEUE 32 //Power of 2, holds two config saves (2 x 12 bytes)
+volatile int ee_adr[EE_QUEUE];
+volatile uint8_t ee_dat[EE_QUEUE];
+volatile uint8_t ee_head = 0; //Next free entry
+volatile uint8_t ee_tail = 0; //Next entry to write
+void ee_write_byte(int, uint8_t);
+uint8_t ee_read_byte(int);
+void ee_flush(void);
+
+//Config block: RAM copy of all settings, read at boot in one block,
+//single fields are written back with CONFIG_SAVE()
+struct config
+{
+	uint8_t version;
+	int32_t f[MAXBANDS][2];   //Stored VFO A/B frequency for each band
+	int16_t tx_preset[MAXBANDS];
+	int32_t f_lo[2];          //LSB/USB LO
+	int16_t thresh;
+	int16_t rx_att;
+	int16_t agc;
+	int16_t tone;
+	uint16_t crc;
+} __attribute__((packed)) cfg;
+#define CONFIG_SAVE(field, var) config_write(&cfg.field, &(var), sizeof(cfg.field))
+void config_load(void);
+void config_defaults(void);
+void config_migrate(void);
+void config_put(int, int, int);
+void config_write(void*, const void*, int);
+uint16_t config_crc(void);
 long load_frequency(int, int);
 int load_band(void);
 int load_vfo(int);
 void store_frequency(int, int, long);
 void store_current_operation(int, int, int, long);
+int load_current_operation(void);
+uint8_t log_chksum(uint8_t*);
+int log_valid(uint8_t*);
+void log_read(int, uint8_t*);
+int log_pos = -1;        //Slot of newest record, -1 = log empty
+uint8_t log_rec[LOG_REC]; //Header of newest record and all current fields
+uint8_t log_cnt = LOG_FULL; //Records since last full one
+
+//MEMORY
+//Index keeps a 16 bit sort key per channel (band, offset in 128Hz units), so binary
+//search only reads EEPROM for channels within 128Hz of each other. A full key
+//(band, offset in Hz = 23 bits) would cost 384 bytes of the 2K SRAM.
+uint8_t mem_idx[MEM_CHANNELS]; //Used channels sorted by band and frequency
+uint16_t mem_key[MEM_CHANNELS]; //Sort key of mem_idx[] entries
+#define MEM_KEY(v) ((uint16_t) ((v) >> 16))
+uint8_t mem_used[MEM_CHANNELS / 8]; //Bitmap of used channels
+int mem_cnt = 0;
+unsigned long mem_get(int);
+void mem_put(int, unsigned long);
+unsigned long mem_encode(void);
+void mem_apply(unsigned long);
+int mem_search(unsigned long);
+void mem_index_add(int, unsigned long);
+void mem_index_remove(int);
+void mem_index_build(void);
+int mem_store(void);
+void mem_show(int);
+void mem_recall_open(void);
+void mem_recall_event(int, int);
+long mem_freq(unsigned long);
+int mem_active(unsigned long, uint8_t*, unsigned long, uint8_t*);
+int mem_scan_hold(int);
+void mem_commit(void);
 
 //ADC
+void adc_init(void);
+
+//KEYS
+//Key scanner runs every ms from timer 0, classifies ADC0 thru key_lut[],
+//debounces and puts events (key number | event type) into key_queue[]
+#define KEY_EV_SHORT 0x00  //Released before KEY_T_LONG
+#define KEY_EV_LONG 0x10   //Held for KEY_T_LONG
+#define KEY_EV_REPEAT 0x20 //Still held, every KEY_T_REPEAT
+#define KEY_T_DEBOUNCE 20  //ms
+#define KEY_T_LONG 800
+#define KEY_T_REPEAT 250
+#define KEY_QUEUE 8
+volatile uint8_t key_queue[KEY_QUEUE];
+volatile uint8_t key_q_in = 0, key_q_out = 0;
+uint8_t key_raw = 0, key_stable = 0, key_cnt = 0;
+unsigned int key_held = 0, key_rep = 0;
+volatile unsigned int ms_ticks = 0;
+
+//Key number for ADC0 >> 2 (key_value 39, 76, 103, 135 +/- ~12)
+const uint8_t key_lut[256] PROGMEM = {
+	0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0,  //ADC   0.. 63
+	2, 2, 2, 2, 2, 2, 0, 3, 3, 3, 3, 3, 3, 0, 0, 4,  //ADC  64..127
+	4, 4, 4, 4, 4, 4                                 //ADC 128..151, rest 0 = no key
+};
+
+void key_scan(void);
+void key_put(uint8_t);
+int get_key_event(void);
 int get_keys(void);
+void select_vfo(int);
+void qsy_band(int);
+
+//ADC sampler: conversion complete IRQ runs thru adc_schedule[] round robin
+//and leaves the latest result of every channel in adc_val[]
+//Prescaler 64 => 13 ADC clocks = 52us per conversion, 12 slots = 624us per round
+#define ADC_SLOTS 12
+const uint8_t adc_schedule[ADC_SLOTS] PROGMEM = {1, 0, 1, 7, 1, 2, 1, 3, 1, 7, 1, 6}; //S-Meter every 2nd slot
+volatile int adc_val[8];
+volatile uint8_t adc_slot = 0;
+
+//PTT detection on ADC7 (sampled every 312us) with hysteresis and debounce
+#define PTT_ON 1000     //ADC7 above => TX
+#define PTT_OFF 900     //ADC7 below => RX
+#define PTT_DEBOUNCE 3  //Consecutive samples needed to change state
+volatile uint8_t ptt_tx = 0;    //Debounced PTT state
+volatile uint8_t ptt_event = 0; //Set by ISR on changeover, cleared by main()
+volatile uint8_t ptt_cnt = 0;
+void ptt_changeover(void);
 
 //MENU
 void lcd_drawbox(int, int, int, int);
 int menu0_get_xp(int);
 int menu0_get_yp(int);
-long menu0(long, int);
-long menu1(long, int, int);
-void print_menu_head(char*, int);
-int navigate_thru_item_list(int, int, int);
+void print_menu_head(const char*, int);
 void print_menu_item_list(int, int);
 void print_menu_item(int, int, int);
 
+//UI screens: *_open() draws a screen, *_event() takes one short key press (1..3)
+//or encoder step (dir = +/-1) and returns, so the task table keeps running
+#define UI_MAIN 0
+#define UI_MENU0 1
+#define UI_MENU1 2
+#define UI_LO_SET 3
+#define UI_TX_PRESET 4
+#define UI_THRESH 5
+#define UI_RITXIT 6
+#define UI_TUNE 7
+#define UI_TASKS 8
+#define UI_RECALL 9
+#define UI_HITS 10
+#define UI_XBAND 11
+#define UI_VIEW 12 //Read-only screen, any key closes
+#define UI_ON_MAIN (ui_screen == UI_MAIN || ui_screen == UI_TX_PRESET || ui_screen == UI_RITXIT || ui_screen == UI_TUNE) //Main screen visible
+int ui_screen = UI_MAIN;
+int ui_menu = 0, ui_pos = 0, ui_val = 0; //Open menu, cursor, value under edit
+long ui_old = 0; //Frequency or channel data restored when screen is left without key 2
+void ui_event(int, int);
+void ui_close(void);
+void menu0_open(void);
+void menu0_event(int, int);
+void menu0_show_item(int, int);
+void menu1_open(int);
+void menu1_event(int, int);
+void lo_set_open(int);
+void lo_set_event(int, int);
+void tx_preset_open(void);
+void tx_preset_event(int, int);
+void thresh_open(void);
+void thresh_event(int, int);
+void ritxit_open(int);
+void ritxit_event(int, int);
+void tune_open(void);
+void tune_event(int, int);
+void task_show_open(void);
+void task_show_event(int, int);
+void task_show_refresh(void);
+void view_event(int, int);
+
+//Menu descriptors in flash: menu select name, title, number of items - 1,
+//setting the cursor starts on (0 = first item), preview called when the
+//cursor moves (and with the setting on quit), item labels and actions.
+//Actions get the item number
+struct menu_desc
+{
+	char name[5];
+	char title[9];
+	uint8_t items;
+	int *setting;
+	void (*preview)(int);
+	char item[MENUITEMS][8];
+	void (*action[MENUITEMS])(int);
+};
+void preview_vfo(int);
+void preview_lo(int);
+void menu_band(int);
+void menu_att(int);
+void menu_dual_watch(int);
+void menu_sideband(int);
+void menu_if_sweep(int);
+void menu_autolo(int);
+void menu_tone(int);
+void menu_scan(int);
+void menu_scan_vfo(int);
+void menu_thresh(int);
+void menu_mem_scan(int);
+void menu_split(int);
+void menu_agc(int);
+void menu_tx_preset(int);
+void menu_sleep(int);
+void menu_tune(int);
+void menu_ritxit_off(int);
+void menu_recall(int);
+void menu_store(int);
+void menu_hits(int);
+void menu_histo(int);
+void menu_xband(int);
+void menu_tasks(int);
+const struct menu_desc menus[MENUSTRINGS] PROGMEM = {
+	{"BAND", "BAND SET", 4, &cur_band, 0,
+	 {"80m    ", "40m    ", "20m    ", "17m    ", "15m    "}, {menu_band, menu_band, menu_band, menu_band, menu_band}},
+	{"ATT ", "RX ATT", 1, &rx_att, set_att,
+	 {"OFF    ", "ON     "}, {menu_att, menu_att}},
+	{"VFO ", "VFO", 2, &cur_vfo, preview_vfo,
+	 {"VFO A  ", "VFO B  ", "DUAL W "}, {select_vfo, select_vfo, menu_dual_watch}},
+	{"SIDE", "SIDEBAND", 3, &sideband, preview_lo,
+	 {"LSB    ", "USB    ", "IF PLOT", "AUTO LO"}, {menu_sideband, menu_sideband, menu_if_sweep, menu_autolo}},
+	{"TONE", "TONE", 1, &cur_tone, set_tone,
+	 {"LO     ", "HI     "}, {menu_tone, menu_tone}},
+	{"SCAN", "SCAN", 4, 0, 0,
+	 {"f0..f1 ", "VFO A/B", "THRESH ", "MEMORY ", "FAST   "}, {menu_scan, menu_scan_vfo, menu_thresh, menu_mem_scan, menu_scan}},
+	{"SPLT", "SPLIT", 1, &split, 0,
+	 {"OFF    ", "ON     "}, {menu_split, menu_split}},
+	{"AGC ", "AGC", 1, &agc, set_agc,
+	 {"FAST   ", "SLOW   "}, {menu_agc, menu_agc}},
+	{"ADJ ", "ADJUST", 4, 0, 0,
+	 {"SET LSB", "SET USB", "TX GAIN", "SLEEP  ", "TUNE   "}, {lo_set_open, lo_set_open, menu_tx_preset, menu_sleep, menu_tune}},
+	{"RIT ", "RIT/XIT", 2, 0, 0,
+	 {"RIT    ", "XIT    ", "OFF    "}, {ritxit_open, ritxit_open, menu_ritxit_off}},
+	{"MEM ", "MEMORY", 4, 0, 0,
+	 {"RECALL ", "STORE  ", "HITS   ", "HISTO  ", "X-BAND "}, {menu_recall, menu_store, menu_hits, menu_histo, menu_xband}},
+	{"SYS ", "SYSTEM", 0, 0, 0,
+	 {"TASKS  "}, {menu_tasks}}};
+
 //MCP4725
 #define MCP4725_ADDR 0xC2 //Chinese board with A0 to VCC
-void tx_preset_adjust(void);
 void mcp4725_set_value(int);
 void store_tx_preset(int, int);
 int load_tx_preset(int);
 
 //METER
-long runseconds10s = 0;
 int sv_old = 0;
 
+//Volts measurement
+int adc_v;
+int adc_v_old = 0;
+
 //ST7735 LCD
 void lcd_init(void);
 void lcd_reset(void);                                    //Reset LCD
@@ -543,14 +867,82 @@ void lcd_setwindow(int, int, int, int);                  //Define output window
 void lcd_setpixel(int, int, unsigned int);               //Set 1 Pixel
 void lcd_cls0(unsigned int);                              //Clear LCD
 void lcd_putchar(int, int, unsigned char, unsigned int, unsigned int, int, int); //Write one char to LCD (double size, variable height)
-void lcd_putstring(int, int, char*, unsigned int, unsigned int, int, int);       //Write \0 terminated string to LCD (double size, variable height)
-void lcd_putstring2(int, int, char*, unsigned int, unsigned int, int);
+void lcd_putstring_P(int, int, const char*, unsigned int, unsigned int, int, int); //Write \0 terminated string in flash to LCD (double size, variable height)
+void lcd_putstring2_P(int, int, const char*, unsigned int, unsigned int, int);
 int lcd_putnumber(int, int, long, int, int, int, int, int);                     //Write a number (int or long) to LCD (double size, variable height)
+int lcd_putnumber_r(int, int, long, int, int, int, int, int, int);              //Same, right aligned in a field of n chars
 
 //Scanning QRG
 long scan_f0_f1(void);
 long scan_vfoa_vfob(void);
-void set_scan_threshold(void);
+long scan_engine(long*, int, int, int, int, int*);
+int scan_hold(long*);
+long scan_coarse_fine(void);
+long scan_refine(long, long, int, int, int*);
+#define SCAN_STEP 100    //Hz
+#define SCAN_COARSE 2000 //Hz, coarse step close to SSB bandwidth
+#define SCAN_REFINE_DB 4 //Fine search if S value is this far over noise floor
+#define SCAN_SETTLE 3    //ms for Si5351 and IF after step, S-Meter attack needs ~1ms more
+#define SCAN_REFRESH 200 //ms between display updates while scanning
+void memory_scan(void);
+#define MEM_PRIO_INTERVAL 2000 //ms between checks of priority channel CH 0
+void xband_open(void);
+void xband_event(int, int);
+void xband_show(void);
+void xband_scan(void);
+#define RELAY_SETTLE 20 //ms for band relays and LO after band change
+uint8_t xband_mask = (1 << MAXBANDS) - 1; //Bands selected for cross-band scan
+void dual_watch(void);
+void dw_bar(int, int, unsigned int);
+void dw_show_times(int);
+#define DW_DWELL 30 //ms on each VFO incl. settle time
+#define DW_SETTLE 3 //ms after hop before S-Meter is sampled
+int dw_dwell = DW_DWELL, dw_settle = DW_SETTLE;
+
+//Scan hits: ring buffer of scan stops and hit count per 1/16 of each band
+#define HITS 8 //Power of 2
+#define HIST_BINS 16
+#define HIST_HEIGHT 70 //Max. bar height in pixels
+#define HIST_BOTTOM 108
+long hit_f[HITS];
+uint8_t hit_s[HITS];        //Peak S in dB over S0
+unsigned int hit_t[HITS];   //Seconds since power on
+uint8_t hit_pos = 0, hit_cnt = 0;
+uint8_t hist[MAXBANDS][HIST_BINS];
+void hit_add(long, int);
+void hit_tune(long);
+void hits_open(void);
+void hits_event(int, int);
+void hits_show(int);
+void hist_open(void);
+
+//Scheduler
+//Static task table, index is priority (0 = highest), driven by the 1ms tick
+#define TASKS 6
+struct task
+{
+	void (*run)(void);
+	unsigned int period;  //ms
+	unsigned int due;     //Deadline, ms tick of next run
+	unsigned int t_max;   //Longest run time in ms
+	uint8_t overruns;     //Runs started more than one period late
+};
+void sched_run(void);
+void task_ptt(void);
+void task_tune(void);
+void task_keys(void);
+void task_meter(void);
+void task_sensors(void);
+void task_msg(void);
+const char task_str[TASKS][6] PROGMEM = {"PTT", "TUNE", "KEYS", "METER", "SENS", "MSG"};
+struct task tasks[TASKS] = {{task_ptt, 1, 0, 0, 0},
+	                        {task_tune, 5, 0, 0, 0},
+	                        {task_keys, 10, 0, 0, 0},
+	                        {task_meter, 100, 0, 0, 0},
+	                        {task_sensors, 1000, 0, 0, 0},
+	                        {task_msg, 500, 0, 0, 0}};
+unsigned int task_max_snap[TASKS]; //Counters when task screen was opened
+uint8_t task_ovr_snap[TASKS];
 
 int main(void);
 
@@ -561,10 +953,6 @@ int main(void);
 void mcp4725_set_value(int v)
 {
     int value = v;
-    char *s1, *s2;
-    
-    s1 = malloc(16);
-    s2 = malloc(16);
     
     twi_start();
     twi_write(MCP4725_ADDR); //Device address
@@ -573,94 +961,68 @@ void mcp4725_set_value(int v)
     twi_write((value & 0x0F)); //4LSBs
     twi_stop();			
 	
-	strcpy(s1, "TX PRESET:");
-	int2asc(v, -1, s2, 15);	
-	strcat(s1, s2);
-	//nt xpos = 0, ypos = 8 * FONTHEIGHT;	
-	show_msg(s1);
-	free(s1);
-	free(s2);
+	show_msg_P(PSTR("TX PRESET:"));
+	lcd_putnumber(10 * FONTWIDTH, 8 * FONTHEIGHT, v, -1, WHITE, backcolor, 1, 1);
 } 
 
-void tx_preset_adjust(void)
+//TX preset is adjusted on main screen, DAC follows encoder
+void tx_preset_open(void)
 {
-	int key = 0;
-	int v1 = tx_preset[cur_band], v1_old;
-	
-	v1_old = v1;			
-    show_msg("TX PRESET=    ");
-    mcp4725_set_value(v1);
-    
-	while(get_keys());
-	key = get_keys();
-			
-	while(!key)
+	ui_screen = UI_TX_PRESET;
+	ui_val = tx_preset[cur_band];
+    mcp4725_set_value(ui_val); //Writes its own status line, prompt goes over it
+    show_msg_P(PSTR("TX PRESET="));
+	lcd_putnumber(10 * FONTWIDTH, 8 * FONTHEIGHT, ui_val, -1, WHITE, backcolor, 1, 1);
+}
+
+//Key 2 stores, other keys restore preset of current band
+void tx_preset_event(int key, int dir)
+{
+	if(dir)
 	{
-		if(tuningknob >= 1)  //Turn CW
+		ui_val += dir * 10;
+		if(ui_val > 4095)
 		{
-		    if(v1 < 4085)
-		    {
-				v1 += 10;
-			}
-			else
-			{
-				v1 = 4095;
-			}			
-		    tuningknob = 0;
-		} 
-
-		if(tuningknob <= -1) //Turn CCW
-		{    
-		    if(v1 > 10)
-		    {
-				v1 -= 10;
-			}
-			else
-			{
-				v1 = 0;
-			}
-			
-		    tuningknob = 0;
-		}	
-		
-		if(v1 != v1_old)
+			ui_val = 4095;
+		}
+		if(ui_val < 0)
 		{
-		    mcp4725_set_value(v1);
-		}    
-		v1_old = v1;
-		
-		key = get_keys();
-	}	
+			ui_val = 0;
+		}
+		mcp4725_set_value(ui_val);
+	}
 	
 	if(key == 2)
 	{
-		tx_preset[cur_band] = v1;
-		store_tx_preset(v1, cur_band);
+		tx_preset[cur_band] = ui_val;
+		store_tx_preset(ui_val, cur_band);
 	}	
+	else if(key)
+	{
+		mcp4725_set_value(tx_preset[cur_band]);
+	}
+	
+	if(key)
+	{
+		ui_screen = UI_MAIN; //Main screen is still there
+	}
 }
 
 void store_tx_preset(int value, int band)
 {
-	//MSB first
-    int adr = 128 + band * 2;
-    
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)adr++, (value >> 8) & 0x0f);
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)adr, value & 0xff);
-    show_msg("TX preset stored.");
+	CONFIG_SAVE(tx_preset[band], value);
+    show_msg_P(PSTR("TX preset stored."));
 }	
 
+//TX preset from old EEPROM layout
 int load_tx_preset(int band)
 {
 	//MSB first
 	int adr = 128 + band * 2;
     int v = 0;
     
-    while(!eeprom_is_ready());
-    v = eeprom_read_byte((uint8_t*)adr++) << 8;
-    while(!eeprom_is_ready());
-    v += eeprom_read_byte((uint8_t*)adr);
+    v = ee_read_byte(adr++) << 8;
+    v += ee_read_byte(adr);
         
     if(v >= 0 && v <= 4095)
     {
@@ -678,9 +1040,21 @@ void set_lo(int sb)
     si5351_set_freq(SYNTH_MS_0, f_lo[sb]);	
 }	
 
+//Set VFO, RIT and XIT are added here so f_vfo keeps the dial frequency
 void set_vfo(long f)
 {
-    si5351_set_freq(SYNTH_MS_1, f);	
+	si5351_calc_regs(f + rit, vfo_regs[0]);
+	
+	if(xit != rit)
+	{
+	    si5351_calc_regs(f + xit, vfo_regs[1]);
+	}
+	else
+	{
+		memcpy(vfo_regs[1], vfo_regs[0], 8);
+	}
+		
+    si5351_write_regs(SYNTH_MS_1, vfo_regs[txrx]);	
 }	
 
 ////////////////////////////////
@@ -747,6 +1121,15 @@ void si5351_start(void)
 }
 
 void si5351_set_freq(int synth, long freq)
+{
+  uint8_t regs[8];
+  
+  si5351_calc_regs(freq, regs);
+  si5351_write_regs(synth, regs);
+}
+
+//Calculate the 8 multisynth registers for freq (AN619)
+void si5351_calc_regs(long freq, uint8_t *regs)
 {
   unsigned long  a, b, c = CFACTOR; 
   unsigned long f_xtal = 25000000;
@@ -760,15 +1143,58 @@ void si5351_set_freq(int synth, long freq)
   p1  = 128 * a + (unsigned long) (128 * b / c) - 512;
   p2 = 128 * b - c * (unsigned long) (128 * b / c);
     
-  //Write data to multisynth registers of synth n
-  si5351_write(synth, 0xFF);      //1048575 MSB
-  si5351_write(synth + 1, 0xFF);  //1048575 LSB
-  si5351_write(synth + 2, (p1 & 0x00030000) >> 16);
-  si5351_write(synth + 3, (p1 & 0x0000FF00) >> 8);
-  si5351_write(synth + 4, (p1 & 0x000000FF));
-  si5351_write(synth + 5, 0xF0 | ((p2 & 0x000F0000) >> 16));
-  si5351_write(synth + 6, (p2 & 0x0000FF00) >> 8);
-  si5351_write(synth + 7, (p2 & 0x000000FF));
+  regs[0] = 0xFF;      //1048575 MSB
+  regs[1] = 0xFF;      //1048575 LSB
+  regs[2] = (p1 & 0x00030000) >> 16;
+  regs[3] = (p1 & 0x0000FF00) >> 8;
+  regs[4] = (p1 & 0x000000FF);
+  regs[5] = 0xF0 | ((p2 & 0x000F0000) >> 16);
+  regs[6] = (p2 & 0x0000FF00) >> 8;
+  regs[7] = (p2 & 0x000000FF);
+}
+
+//Write register image to multisynth of synth n
+//Only the span of registers that differ from the last image is sent,
+//as one burst (Si5351 auto increments the register address).
+//A small offset (RIT/XIT, tuning step) usually touches the P2 bytes only.
+void si5351_write_regs(int synth, uint8_t *regs)
+{
+  uint8_t *shadow = si5351_shadow[(synth - SYNTH_MS_0) >> 3];
+  int t1, first = -1, last = -1;
+  
+  for(t1 = 0; t1 < 8; t1++)
+  {
+	  if(regs[t1] != shadow[t1])
+	  {
+		  if(first == -1)
+		  {
+		      first = t1;
+		  }
+		  last = t1;
+	  }
+  }
+  
+  //Register 0 is always 0xFF once written, so 0 means "never written" => send all
+  if(shadow[0] != 0xFF)
+  {
+	  first = 0;
+	  last = 7;
+  }
+  
+  if(first == -1)
+  {
+	  return;
+  }
+  
+  twi_start();
+  twi_write(SI5351_ADDRESS);
+  twi_write(synth + first);
+  for(t1 = first; t1 <= last; t1++)
+  {
+      twi_write(regs[t1]);
+      shadow[t1] = regs[t1];
+  }  
+  twi_stop();
 }
 
 
@@ -781,1851 +1207,4231 @@ void si5351_set_freq(int synth, long freq)
 //Scan from VFOA to VFOB or vice versa
 long scan_f0_f1(void)
 {
+	long f[2];
+	int idx;
 	
-	int t1;
-	int key = 0;
-	int sval = 0;
-	long fx, f[2], ftmp;
-	char *s = "SCANNING...";
-	char *bstr;
-	int xpos0 = (16 - strlen(s)) / 2;
-	int ypos0 = 1;
-	int wait;
-	long runsecs10thresh;
-	int msg_sent; 	
-	bstr = malloc(17);
-	for(t1 = 0; t1 < 17; t1++)
+	if(f_vfo[cur_band][0] < f_vfo[cur_band][1])
+	{
+	    f[0] = f_vfo[cur_band][0];
+	    f[1] = f_vfo[cur_band][1];
+	}
+	else
 	{
-		bstr[t1] = 0;
+	    f[0] = f_vfo[cur_band][1];
+	    f[1] = f_vfo[cur_band][0];
 	}	
-	for(t1 = 0; t1 < 16; t1++)
+	
+	return scan_engine(f, 0, SCAN_STEP, 0, SCAN_SETTLE, &idx);
+}	
+
+//Scan from VFOA to VFOB with coarse steps, fine search around signals
+long scan_coarse_fine(void)
+{
+	long f[2];
+	int idx;
+	
+	if(f_vfo[cur_band][0] < f_vfo[cur_band][1])
 	{
-		bstr[t1] = 32;
+	    f[0] = f_vfo[cur_band][0];
+	    f[1] = f_vfo[cur_band][1];
+	}
+	else
+	{
+	    f[0] = f_vfo[cur_band][1];
+	    f[1] = f_vfo[cur_band][0];
 	}	
 	
-	for(t1 = 0; t1 < 2; t1++)
+	return scan_engine(f, 0, SCAN_COARSE, SCAN_STEP, SCAN_SETTLE, &idx);
+}	
+
+//Alternate between VFO A and B, returns f=Bit0..Bit27; VFO=Bit28
+long scan_vfoa_vfob(void)
+{
+	int idx;
+	long f = scan_engine(f_vfo[cur_band], 2, 0, 0, SCAN_SETTLE, &idx);
+	
+	if(f)
 	{
-	    f[t1] = f_vfo[cur_band][t1];
-	}    
+		return ((long) idx << 28) + f;
+	}
+	return 0;
+}	
+
+//Stay on active frequency with manual tuning until signal has gone for 3 seconds,
+//PTT counts as key 2: scan ends on this QRG to answer the station
+int scan_hold(long *fx)
+{
+	int key = 0;
+	int sval, peak = 0;
+	long ftmp;
+	long runsecs10thresh = runseconds10;
+	
+	show_msg_P(PSTR("Stopped."));
+	lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, *fx / 100, 1, WHITE, backcolor, 1, 1);
 	
-	if(f[0] > f[1])
+	while(runsecs10thresh + 30 > runseconds10 && !key)
 	{
-		ftmp = f[0];
-		f[0] = f[1];
-		f[1] = ftmp;
-	}	
+		sval = get_s_value();
+		if(sval > squelch_level() - SQ_HYST)
+		{
+			runsecs10thresh = runseconds10;
+		}
+		if(sval > peak)
+		{
+			peak = sval;
+		}
+		show_smeter();
+		key = get_keys();
+		if(ptt_tx)
+		{
+			key = 2;
+		}
+		
+		//Manual tuning	
+		ftmp = tune_frequency(*fx);
+		if(ftmp)
+		{
+			*fx = ftmp;
+			set_vfo(*fx + f_lo[sideband]);
+			lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, *fx / 100, 1, WHITE, backcolor, 1, 1);
+			runsecs10thresh = runseconds10;
+		}
+	}
+	hit_add(*fx, peak);
+	show_msg_P(PSTR("Scanning..."));
 	
-	lcd_cls0(backcolor);
-	lcd_putstring(0, ypos0 * FONTHEIGHT, bstr, WHITE, LIGHTBLUE, 1, 1);	
-	lcd_putstring(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, s, WHITE, LIGHTBLUE, 1, 1);	
-	free(bstr);
+	return key;
+}
+
+//Step thru fa..fb with fine steps, VFO is left on frequency with highest S value
+long scan_refine(long fa, long fb, int fine, int settle, int *peak)
+{
+	long fx, fpeak = fa;
+	int sval;
+	unsigned int t0;
+	uint8_t regs[8];
+	
+	*peak = -1;
+	for(fx = fa; fx <= fb; fx += fine)
+	{
+		si5351_calc_regs(fx + f_lo[sideband] + rit, regs);
+		si5351_write_regs(SYNTH_MS_1, regs);
+		smeter_reset();
+		t0 = get_ms();
+		while(get_ms() - t0 < settle + 1);
+		
+		sval = get_s_value();
+		if(sval > *peak)
+		{
+			*peak = sval;
+			fpeak = fx;
+		}
+	}
+	set_vfo(fpeak + f_lo[sideband]);
 	
-	while(get_keys());
+	return fpeak;
+}	
+
+//Scan engine: range mode (n = 0) steps from f[0] to f[1] by step Hz,
+//with fine > 0 a signal found at coarse step is searched for its peak in fine steps,
+//list mode hops thru f[0..n-1]. Each step writes a prepared register image,
+//the next image is calculated during settle time, then the S-Meter is sampled.
+//Frequency, meter, steps/s and time per pass are shown every SCAN_REFRESH ms only.
+//Returns frequency (*idx = list entry) on key 2, 0 on key 3 or PTT while stepping
+long scan_engine(long *f, int n, int step, int fine, int settle, int *idx)
+{
+	int key = 0;
+	int sval;
+	int i = 0, i_next = 0, cur = 0;
+	unsigned int steps = 0, steps_s = 0;
+	unsigned int t0, t_disp, t_rate;
+	long fx = f[0], f_next;
+	long runsecs10pass = runseconds10, pass10 = 0;
+	uint8_t regs[2][8];
 	
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(3 * FONTWIDTH, FONTHEIGHT, PSTR("SCANNING..."), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(4 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("/s"), WHITE, backcolor, 1, 1);	
+	lcd_putstring_P(15 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("s"), WHITE, backcolor, 1, 1);	
 	draw_meter_scale(0);
-		
-	while(key != 2)
+	
+	si5351_calc_regs(fx + f_lo[sideband] + rit, regs[0]);
+	t_disp = t_rate = get_ms();
+	
+	while(1)
 	{
-	    for(fx = f[0]; fx < f[1]; fx += 100)
-	    {
-			key = get_keys();
-			
-			set_vfo(fx + f_lo[sideband]);
-			lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
-			sval = get_s_value();
-			show_meter(sval);
-			
-			msg_sent = 0;
-			while(sval > thresh && !key)
+		si5351_write_regs(SYNTH_MS_1, regs[cur]);
+		smeter_reset();
+		t0 = get_ms();
+		steps++;
+		
+		if(n)
+		{
+			i_next = i + 1;
+			if(i_next >= n)
 			{
-				if(!msg_sent) //Just post msg once!
-				{
-				   show_msg("Stopped.");
-				   msg_sent = 1;
-				}   
-			    sval = get_s_value();
-			    show_meter(sval);
-			    key = get_keys();
-			    wait = 1;
-			    
-			    //Manual tuning	
-			    ftmp = tune_frequency(fx);
-			    if(ftmp)
-			    {
-				    fx = ftmp;
-				    set_vfo(fx + f_lo[sideband]);
-			        lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
-			     }
+				i_next = 0;
 			}
-			
-			
-			//Wait if strong sig detected
-			runsecs10thresh = runseconds10;
-			if(wait)
+			f_next = f[i_next];
+		}
+		else
+		{
+			f_next = fx + step;
+			if(f_next >= f[1])
 			{
-				msg_sent = 0;
-			    while(runsecs10thresh + 30 > runseconds10)
-			    {
-					if(!msg_sent) //Just post msg once!
-				    {
-				        show_msg("Waiting...");
-			            msg_sent = 1;
-			        }   
-			      
-			        key = get_keys();
-			        
-			        if(key) //Fast out!
-			        {
-						runsecs10thresh = 0;
-					}	
-					
-					//Manual tuning	
-					ftmp = tune_frequency(fx);
-					if(ftmp)
-					{
-						fx = ftmp;
-						set_vfo(fx + f_lo[sideband]);
-						lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
-					}
-			    }	
-			}   
-			 
-			if(wait)
+				f_next = f[0];
+			}
+		}
+		si5351_calc_regs(f_next + f_lo[sideband] + rit, regs[cur ^ 1]);
+		
+		while(get_ms() - t0 < settle + 1);
+		
+		sval = get_s_value();
+		noise_update(sval);
+		if(fine && sval > refine_level())
+		{
+			fx = scan_refine(fx - step / 2, fx + step / 2, fine, settle, &sval);
+		}
+		
+		if(sval > squelch_level())
+		{
+			key = scan_hold(&fx);
+			if(n)
 			{
-				show_msg("Scanning...");
-			    wait = 0;
-			}   
-			
-			//Manual tuning	
-			ftmp = tune_frequency(fx);
-			if(ftmp)
+				f[i] = fx;
+			}
+			else if(f_next != f[0])
 			{
-				fx = ftmp;
-				set_vfo(fx + f_lo[sideband]);
-			    lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
+				f_next = fx + step;
+				si5351_calc_regs(f_next + f_lo[sideband] + rit, regs[cur ^ 1]);
 			}
-
-			
-			//Key handler
-			switch(key)
+		}
+		
+		//Pass complete
+		if((n && !i_next) || (!n && f_next == f[0]))
+		{
+			pass10 = runseconds10 - runsecs10pass;
+			runsecs10pass = runseconds10;
+		}
+		
+		if(get_ms() - t_rate >= 1000)
+		{
+			steps_s = steps;
+			steps = 0;
+			t_rate += 1000;
+		}
+		
+		//Display at fixed rate, independent of step rate, not with PTT pending
+		if(get_ms() - t_disp >= SCAN_REFRESH && !ptt_tx)
+		{
+			lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
+			if(n)
 			{
-				    case 2: return fx;
-				            break;
-				    case 3: return 0;
-				            break;        
-			}	   
-			key = 0;		
+				lcd_putchar(1 * FONTWIDTH, 4 * FONTHEIGHT, i + 65, LIGHTYELLOW, backcolor, 1, 1);
+			}
+			lcd_putnumber_r(0, 2 * FONTHEIGHT, steps_s, -1, 4, WHITE, backcolor, 1, 1);
+			lcd_putnumber_r(9 * FONTWIDTH, 2 * FONTHEIGHT, pass10, 1, 6, WHITE, backcolor, 1, 1);
+			show_smeter();
+			t_disp = get_ms();
 		}
-	}	
 		
+		if(!key)
+		{
+			key = get_keys();
+		}
+		if(!key && ptt_tx) //Back to VFO before changeover
+		{
+			key = 3;
+		}
+		
+		switch(key)
+		{
+			case 2: *idx = i;
+			        return fx;
+			case 3: set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+			        return 0;
+		}
+		key = 0;
+		
+		fx = f_next;
+		i = i_next;
+		cur ^= 1;
+	}
+	
 	return 0;
 }	
 
-long scan_vfoa_vfob(void)
+//Hop to channel with prepared VFO register image and check S-Meter after settling,
+//image for the following channel is calculated during settle time
+int mem_active(unsigned long v, uint8_t *regs, unsigned long v_next, uint8_t *regs_next)
 {
+	unsigned int t0;
+	int sb = (v >> 3) & 1;
+	int sval;
 	
-	int t1;
-	int key = 0;
-	int sval = 0;
-	long ftmp;
-	char *s = "SCANNING...";
-	char *bstr;
-	int xpos0 = (16 - strlen(s)) / 2;
-	int ypos0 = 1;
-	
-	long runsecs10thresh;
-	int msg_sent; 	
-	bstr = malloc(17);
-	for(t1 = 0; t1 < 17; t1++)
+	if(sb != sideband)
 	{
-		bstr[t1] = 0;
-	}	
-	for(t1 = 0; t1 < 16; t1++)
+		sideband = sb;
+		set_lo(sideband);
+	}
+	si5351_write_regs(SYNTH_MS_1, regs);
+	smeter_reset();
+	t0 = get_ms();
+	
+	if(regs_next)
 	{
-		bstr[t1] = 32;
-	}	
+		si5351_calc_regs(mem_freq(v_next) + f_lo[(v_next >> 3) & 1] + rit, regs_next);
+	}
 	
-	lcd_cls0(backcolor);
-	lcd_putstring(0, ypos0 * FONTHEIGHT, bstr, WHITE, LIGHTBLUE, 1, 1);	
-	lcd_putstring(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, s, WHITE, LIGHTBLUE, 1, 1);	
-	free(bstr);
+	while(get_ms() - t0 < SCAN_SETTLE + 1);
 	
-	while(get_keys());
+	sval = get_s_value();
+	noise_update(sval);
 	
-	draw_meter_scale(0);
-		
-	while(key != 2)
+	return (sval > squelch_level());
+}
+
+//Stay on active channel until signal has gone for 3 seconds, returns key,
+//PTT counts as key 2 to answer on this channel
+int mem_scan_hold(int ch)
+{
+	int key = 0;
+	int sval, peak = 0;
+	long runsecs10thresh = runseconds10;
+	
+	show_msg_P(PSTR("Stopped."));
+	mem_show(ch);
+	
+	while(runsecs10thresh + 30 > runseconds10 && !key)
 	{
-	    for(t1  = 0; t1 < 2; t1++)
-	    {
-			key = get_keys();
-			
-			//Display frequency
-			set_vfo(f_vfo[cur_band][t1] + f_lo[sideband]);
-			lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, f_vfo[cur_band][t1] / 100, 1, WHITE, backcolor, 1, 1);
-			sval = get_s_value();
-			show_meter(sval);
-			
-			//Display VFO letter
-			lcd_putchar(1 * FONTWIDTH, 4 * FONTHEIGHT, t1 + 65, LIGHTYELLOW, backcolor, 1, 1);
-			
-			msg_sent = 0;
-			while(sval > thresh && !key)
-			{
-				if(!msg_sent) //Just post msg once!
-				{
-				   show_msg("Stopped.");
-				   msg_sent = 1;
-				}   
-			    sval = get_s_value();
-			    show_meter(sval);
-			    key = get_keys();
-			    
-			    //Manual tuning	
-			    ftmp = tune_frequency(f_vfo[cur_band][t1]);
-			    if(ftmp)
-			    {
-				    f_vfo[cur_band][t1] = ftmp;
-				    set_vfo(f_vfo[cur_band][t1] + f_lo[sideband]);
-			        lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, f_vfo[cur_band][t1] / 100, 1, WHITE, backcolor, 1, 1);
-			        runsecs10thresh = runseconds10;
-			     }
-			}
-					
-			//Wait 3 seconds
+		sval = get_s_value();
+		if(sval > squelch_level() - SQ_HYST)
+		{
 			runsecs10thresh = runseconds10;
-			msg_sent = 0;
-		    while(runsecs10thresh + 30 > runseconds10)
-		    {
-				if(!msg_sent) //Just post msg once!
-			    {
-			        show_msg("Waiting...");
-		            msg_sent = 1;
-		        }   
-		      
-		        key = get_keys();
-		        
-		        if(key) //Fast out!
-		        {
-					runsecs10thresh = 0;
-				}	
-					
-				//Manual tuning	
-				ftmp = tune_frequency(f_vfo[cur_band][t1]);
-				if(ftmp)
-				{
-					f_vfo[cur_band][t1] = ftmp;
-					set_vfo(f_vfo[cur_band][t1] + f_lo[sideband]);
-					lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, f_vfo[cur_band][t1] / 100, 1, WHITE, backcolor, 1, 1);
-					runsecs10thresh = runseconds10;
-				}	
-			}   
-			
-			//Manual tuning	
-			ftmp = tune_frequency(f_vfo[cur_band][t1]);
-			if(ftmp)
-			{
-				f_vfo[cur_band][t1] = ftmp;
-				set_vfo(f_vfo[cur_band][t1] + f_lo[sideband]);
-			    lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, f_vfo[cur_band][t1] / 100, 1, WHITE, backcolor, 1, 1);
-			}
-			
-			//Key handler
-			switch(key)
-			{
-				    case 2: return ((long)t1 << 28) + f_vfo[cur_band][t1]; //f=Bi0..Bit27; VFO=Bit28
-				            break;
-				    case 3: return 0;
-				            break;        
-			}	   
-			key = 0;	
+		}
+		if(sval > peak)
+		{
+			peak = sval;
+		}
+		show_smeter();
+		key = get_keys();
+		if(ptt_tx)
+		{
+			key = 2;
 		}
 	}
-	return 0;
-}	
+	hit_add(mem_freq(mem_get(ch)), peak);
+	show_msg_P(PSTR("Scanning..."));
 
 	
-//Scans 16 memories
-void set_scan_threshold(void)
+	return key;
+}
+
+//Scan memory channels of current band in order of frequency,
+//priority channel CH 0 (if on current band) is checked every MEM_PRIO_INTERVAL
+//Key 2 keeps channel, key 3 or PTT between channels restores old state
+void memory_scan(void)
 {
 	int key = 0;
-    char *s = "SCAN THRESH...";
-	char *bstr;
-	int xpos0 = (16 - strlen(s)) / 2;
-	int ypos0 = 1;
-	int t1;
-    
-    bstr = malloc(17);
-	for(t1 = 0; t1 < 17; t1++)
-	{
-		bstr[t1] = 0;
-	}	
-	for(t1 = 0; t1 < 16; t1++)
+	int pos, next, p0, p1, cur = 0, cnt = 0;
+	int prio = 0;
+	uint8_t regs[2][8], prio_regs[8];
+	unsigned long v, v_next, v_last, v_prio = 0, v_old = mem_encode();
+	unsigned int t_prio, t_rate;
+	
+	p0 = mem_search((unsigned long) cur_band << 29);
+	p1 = mem_search((unsigned long) (cur_band + 1) << 29);
+	if(p0 == p1)
 	{
-		bstr[t1] = 32;
-	}	
-	lcd_cls0(backcolor);
-	lcd_putstring(0, ypos0 * FONTHEIGHT, bstr, WHITE, LIGHTBLUE, 1, 1);	
-	lcd_putstring(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, s, WHITE, LIGHTBLUE, 1, 1);	
-	free(bstr);
+		show_msg_P(PSTR("No memories."));
+		return;
+	}
 	
-	show_meter(thresh);
-    draw_meter_scale(0);
-        
-    lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, thresh, -1, WHITE, backcolor, 1, 1);
-	show_meter(thresh);
-        	
-    while(!key)
-    {
-        if(tuningknob > 2) //Turn CW
+	if(mem_used[0] & 1)
+	{
+		v_prio = mem_get(0);
+		if((v_prio >> 29) == (unsigned long) cur_band)
 		{
-			if(thresh < 12)
-			{
-				thresh++;
-			}
-			show_meter(thresh);
-	
-	        lcd_putstring(5 * FONTWIDTH, 4 * FONTHEIGHT, "    ", WHITE, backcolor, 1, 1);
-            lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, thresh, -1, WHITE, backcolor, 1, 1);
-    
-			tuningknob = 0;
+			prio = 1;
+			si5351_calc_regs(mem_freq(v_prio) + f_lo[(v_prio >> 3) & 1] + rit, prio_regs);
 		}
-
-		if(tuningknob < -2)  //Turn CCW
-		{    
-			if(thresh > 0)
-			{
-				thresh--;
-			}
-			show_meter(thresh);
-			 
-			tuningknob = 0;
-		}		
-		key = get_keys();
 	}
 	
-	if(key == 2)
-	{
-		eeprom_write_byte((uint8_t*)138, thresh);
-	}	
-}
-
-//////////////////////
-//
-// RADIO CONTROl
-//
-/////////////////////
-void set_band(int bcode)
-{
-	int t1 = 0;
-    
-    //RESET PORTB relay bcd decoder
-    PORTD &= ~(1 << PD0);
-    PORTD &= ~(1 << PD1);
-    PORTD &= ~(1 << PD2);
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(3 * FONTWIDTH, FONTHEIGHT, PSTR("MEMORY SCAN"), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(8 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("CH/s"), WHITE, backcolor, 1, 1);	
+	draw_meter_scale(0);
+	show_msg_P(PSTR("Scanning..."));
 	
-	if(bcode < 0) //Return if RESET-Mode has been selected
+	pos = p0;
+	v = mem_get(mem_idx[pos]);
+	si5351_calc_regs(mem_freq(v) + f_lo[(v >> 3) & 1] + rit, regs[0]);
+	t_prio = t_rate = get_ms();
+	
+	while(key != 2 && key != 3)
 	{
-		return;
-	}
+		next = pos + 1;
+		if(next >= p1)
+		{
+			next = p0;
+		}
+		v_next = mem_get(mem_idx[next]);
 		
-	for(t1 = 0; t1 < 3; t1++)
-	{
-	   if(bcode & (1 << t1))
-	   {
-		    PORTD |= (1 << t1);  
-	   }	 
-	   else
-	   {	 
-           PORTD &= ~(1 << t1);
-       }
-    }   
-    
-    //Set LO to preferred sideband of new ham band
-    set_lo(std_sideband[bcode]);
-    show_sideband(std_sideband[bcode], 0);
-}	
-
-//Check if freq is in 20m-band
-int is_band_freq(long f, int cband)
-{
+		v_last = v;
+		cnt++;
+		if(mem_active(v, regs[cur], v_next, regs[cur ^ 1]))
+		{
+			key = mem_scan_hold(mem_idx[pos]);
+		}
+		
+		//Priority channel
+		if(prio && !key && get_ms() - t_prio >= MEM_PRIO_INTERVAL)
+		{
+			v_last = v_prio;
+			cnt++;
+			if(mem_active(v_prio, prio_regs, 0, NULL))
+			{
+				key = mem_scan_hold(0);
+			}
+			t_prio = get_ms();
+		}
+		
+		//Channels per second
+		if(get_ms() - t_rate >= 1000)
+		{
+			lcd_putnumber_r(4 * FONTWIDTH, 2 * FONTHEIGHT, cnt, -1, 4, WHITE, backcolor, 1, 1);
+			cnt = 0;
+			t_rate += 1000;
+		}
+		
+		if(!key)
+		{
+			key = get_keys();
+		}
+		if(!key && ptt_tx)
+		{
+			key = 3;
+		}
+		pos = next;
+		v = v_next;
+		cur ^= 1;
+	}
 	
-	if(f >= band_f0[cband] && f <= band_f1[cband])
+	if(key == 2)
 	{
-	    return 1;
-	}	
+		mem_apply(v_last);
+		mem_commit();
+	}
 	else
 	{
-	    return 0;
-	}		
+		mem_apply(v_old);
+	}
 }
 
-//Calc new frequency from rotary encoder
-long tune_frequency(long fx)
+//Select bands for cross-band scan: encoder moves cursor, key 1 toggles band,
+//key 2 starts scan, key 3 aborts. ui_pos = cursor
+void xband_open(void)
 {
-	long f = fx;
+	ui_screen = UI_XBAND;
+	ui_pos = 0;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(2 * FONTWIDTH, FONTHEIGHT, PSTR("X-BAND SCAN"), WHITE, LIGHTBLUE, 1, 1);	
+	xband_show();
+}	
+
+//Band list with cursor and ON/OFF state
+void xband_show(void)
+{
+	int t1;
 	
-	//Manual tuning	
-	if(tuningknob > 2)  
-	{    
-		f += calc_tuningfactor();
-		tuningknob = 0;
-		return f;
-	}
-		
-	if(tuningknob < -2)
+	for(t1 = 0; t1 < MAXBANDS; t1++)
 	{
-		f -= calc_tuningfactor();
-		tuningknob = 0;
-		return f;
+		lcd_putchar(3 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, (t1 == ui_pos) ? '>' : ' ', YELLOW, backcolor, 1, 1);
+		lcd_putstring_P(5 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, band_str[t1], WHITE, backcolor, 1, 1);
+		if(xband_mask & (1 << t1))
+		{
+			lcd_putstring_P(10 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, PSTR("ON "), LIGHTGREEN, backcolor, 1, 1);
+		}
+		else
+		{
+			lcd_putstring_P(10 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, PSTR("OFF"), LIGHTRED, backcolor, 1, 1);
+		}
 	}
-	return 0;
 }	
 
-//Switch RX ATT on or off
-void set_att(int status)
+void xband_event(int key, int dir)
 {
-	if(status)
+	if(dir)
 	{
-		PORTB |= (1 << PB2);
+		ui_pos += dir;
+		if(ui_pos >= MAXBANDS)
+		{
+			ui_pos = 0;
+		}
+		if(ui_pos < 0)
+		{
+			ui_pos = MAXBANDS - 1;
+		}
+		xband_show();
 	}
-	else
+	
+	switch(key)
 	{
-		PORTB &= ~(1 << PB2);
-	}	
+		case 1: xband_mask ^= (1 << ui_pos);
+		        xband_show();
+		        break;
+		case 2: if(xband_mask)
+		        {
+		            xband_scan();
+		        }
+		        break;
+		case 3: ui_close();
+		        break;
+	}
 }	
 
-//Switch AGC fast or slow
-void set_agc(int status)
+//Cross-band scan: each selected band is stepped thru completely in coarse steps
+//before relays are switched, so RELAY_SETTLE is spent once per band only.
+//Sideband and LO follow std_sideband, signals are refined and recorded as hits
+//without holding. Any key ends scan and shows hits and strongest QRG per band
+//until the next key, PTT ends it without summary once the old band is back
+//for the changeover
+void xband_scan(void)
 {
-	if(status)
+	int key = 0;
+	int b, sval, cur = 0;
+	int old_band = cur_band, old_sb = sideband;
+	int hits[MAXBANDS], s_max[MAXBANDS];
+	long f_max[MAXBANDS];
+	long fx, f_next;
+	unsigned int t0, t_disp;
+	uint8_t regs[2][8];
+	
+	store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]); //Leaving band
+	
+	for(b = 0; b < MAXBANDS; b++)
 	{
-		PORTB &= ~(1 << PB4);
+		hits[b] = 0;
+		s_max[b] = -1;
+		f_max[b] = 0;
 	}
-	else
+	
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(2 * FONTWIDTH, FONTHEIGHT, PSTR("X-BAND SCAN"), WHITE, LIGHTBLUE, 1, 1);	
+	draw_meter_scale(0);
+	t_disp = get_ms();
+	
+	b = 0;
+	while(!key)
 	{
-		PORTB |= (1 << PB4);
-	}	
-}	
-
-//Switch AGC fast or slow
-void set_tone(int status)
-{
-	if(status)
+		if(!(xband_mask & (1 << b)))
+		{
+			b = (b + 1) % MAXBANDS;
+			continue;
+		}
+		
+		//Band change: relays, sideband and LO, then wait once for relays to settle
+		cur_band = b;
+		sideband = std_sideband[b];
+		band_relays(b); //Scan screen stays
+		lcd_putstring_P(12 * FONTWIDTH, 2 * FONTHEIGHT, band_str[b], LIGHTYELLOW, backcolor, 1, 1);
+		fx = band_f0[b];
+		si5351_calc_regs(fx + f_lo[sideband] + rit, regs[cur]);
+		t0 = get_ms();
+		while(get_ms() - t0 < RELAY_SETTLE);
+		
+		//Whole band in one batch
+		while(fx <= band_f1[b] && !key)
+		{
+			si5351_write_regs(SYNTH_MS_1, regs[cur]);
+			smeter_reset();
+			t0 = get_ms();
+			f_next = fx + SCAN_COARSE;
+			si5351_calc_regs(f_next + f_lo[sideband] + rit, regs[cur ^ 1]);
+			while(get_ms() - t0 < SCAN_SETTLE + 1);
+			
+			sval = get_s_value();
+			noise_update(sval);
+			if(sval > refine_level())
+			{
+				fx = scan_refine(fx - SCAN_COARSE / 2, fx + SCAN_COARSE / 2, SCAN_STEP, SCAN_SETTLE, &sval);
+				if(sval > squelch_level())
+				{
+					hit_add(fx, sval);
+					hits[b]++;
+					if(sval > s_max[b])
+					{
+						s_max[b] = sval;
+						f_max[b] = fx;
+					}
+				}
+			}
+			
+			if(get_ms() - t_disp >= SCAN_REFRESH)
+			{
+				lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, fx / 100, 1, WHITE, backcolor, 1, 1);
+				show_smeter();
+				t_disp = get_ms();
+			}
+			
+			key = get_keys();
+			if(ptt_tx)
+			{
+				key = 3;
+			}
+			fx = f_next;
+			cur ^= 1;
+		}
+		b = (b + 1) % MAXBANDS;
+	}
+	
+	//Back to band, sideband and QRG before scan
+	cur_band = old_band;
+	sideband = old_sb;
+	band_relays(cur_band);
+	set_lo(sideband);
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+	if(ptt_tx)
 	{
-		PORTB &= ~(1 << PB5);
+		ui_close();
+		return;
 	}
-	else
+	
+	//Summary: hits and strongest QRG per band
+	ui_screen = UI_VIEW;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(2 * FONTWIDTH, FONTHEIGHT, PSTR("X-BAND HITS"), WHITE, LIGHTBLUE, 1, 1);	
+	for(b = 0; b < MAXBANDS; b++)
 	{
-		PORTB |= (1 << PB5);
-	}	
+		lcd_putstring_P(0, (b + 3) * FONTHEIGHT, band_str[b], WHITE, backcolor, 1, 1);
+		if(!(xband_mask & (1 << b)))
+		{
+			lcd_putstring_P(5 * FONTWIDTH, (b + 3) * FONTHEIGHT, PSTR("-"), GRAY, backcolor, 1, 1);
+			continue;
+		}
+		lcd_putnumber(4 * FONTWIDTH, (b + 3) * FONTHEIGHT, hits[b], -1, LIGHTYELLOW, backcolor, 1, 1);
+		if(hits[b])
+		{
+			lcd_putnumber(8 * FONTWIDTH, (b + 3) * FONTHEIGHT, f_max[b] / 100, 1, WHITE, backcolor, 1, 1);
+		}
+	}
 }	
 
-///////////////////////////
-//
-//         TWI
-//
-///////////////////////////
-void twi_init(void)
+//Horizontal level bar for dual watch, px = 0..119
+void dw_bar(int y, int px, unsigned int color)
 {
-    //set SCL to 400kHz
-    TWSR = 0x00;
-    TWBR = 0x0C;
+	int t1, t2;
 	
-    //enable TWI
-    TWCR = (1<<TWEN);
-}
-
-//Send start signal
-void twi_start(void)
-{
-    TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
-}
-
-//send stop signal
-void twi_stop(void)
-{
-    TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
-}
-
-void twi_write(uint8_t u8data)
-{
-    TWDR = u8data;
-    TWCR = (1<<TWINT)|(1<<TWEN);
-    while ((TWCR & (1<<TWINT)) == 0);
-}
-
-  ///////////////////////
- //       L C D       //
-///////////////////////    
-//Perform hardware reset to LCD
-void lcd_reset(void)
-{
-	LCDPORT |= LCD_RST;  
-	_delay_ms(100);
-	LCDPORT &= ~(LCD_RST);  
-	_delay_ms(100);
-	LCDPORT |= LCD_RST;  
-	_delay_ms(100);
+	lcd_setwindow(0, y, 119, y + 5);
+	lcd_write_command(ST7735_RAMWR);
+	for(t1 = 0; t1 < 6; t1++)
+	{
+		for(t2 = 0; t2 < 120; t2++)
+		{
+			if(t2 < px)
+			{
+				lcd_write_data(color >> 8);
+				lcd_write_data(color & 0xFF);
+			}
+			else
+			{
+				lcd_write_data(backcolor >> 8);
+				lcd_write_data(backcolor & 0xFF);
+			}
+		}
+	}
 }	
 
-//Write command to LCD
-void lcd_write_command(int cmd)
+//Dwell and settle time of dual watch, parameter under edit is highlighted
+void dw_show_times(int edit)
 {
-	int t1;
-	
-	LCDPORT &= ~(LCD_DC_A0);  //Command
-	 
-    LCDPORT &= ~(LCD_CS);     //CS=0
-	
-	for(t1 = 7; t1 >= 0; t1--)
-    {
-	    LCDPORT &= ~(LCD_CLOCK);  //SCL=0	
-	    if(cmd & (1 << t1))
-	    {
-		    LCDPORT |= LCD_DATA;
-	    }
-	    else
-	    {
-		    LCDPORT &= ~(LCD_DATA); 
-	    }
-	    LCDPORT |= LCD_CLOCK;  //SCL=1		
-	}	
-	LCDPORT |= LCD_CS;        //CS=1
+	lcd_putstring_P(0, 8 * FONTHEIGHT, PSTR("                "), WHITE, backcolor, 1, 1);
+	lcd_putchar(0, 8 * FONTHEIGHT, 'D', WHITE, backcolor, 1, 1);
+	lcd_putnumber(2 * FONTWIDTH, 8 * FONTHEIGHT, dw_dwell, -1, edit ? WHITE : YELLOW, backcolor, 1, 1);
+	lcd_putstring_P(5 * FONTWIDTH, 8 * FONTHEIGHT, PSTR("ms"), WHITE, backcolor, 1, 1);
+	lcd_putchar(9 * FONTWIDTH, 8 * FONTHEIGHT, 'S', WHITE, backcolor, 1, 1);
+	lcd_putnumber(11 * FONTWIDTH, 8 * FONTHEIGHT, dw_settle, -1, edit ? YELLOW : WHITE, backcolor, 1, 1);
+	lcd_putstring_P(13 * FONTWIDTH, 8 * FONTHEIGHT, PSTR("ms"), WHITE, backcolor, 1, 1);
 }	
 
-//Write data to LCD
-void lcd_write_data(int dvalue)
+//Dual watch: hop between VFO A and B every dw_dwell ms using prepared register
+//images, S value of each side is sampled after dw_settle. A side with signal
+//above squelch is latched until the signal has gone for 3 seconds.
+//Encoder sets dwell or settle time (key 1 toggles), key 2 keeps the
+//VFO listened to, key 3 returns to former VFO. PTT acts as key 2 on a
+//latched side, as key 3 while hopping, before the changeover runs
+void dual_watch(void)
 {
-	int t1;
+	int key = 0;
+	int side = 0, on = -1, latch = -1, edit = 0;
+	int sval[2] = {0, 0};
+	unsigned int hops = 0, hops_s = 0;
+	unsigned int t0, t_disp, t_rate;
+	long runsecs10latch = 0;
+	uint8_t regs[2][8];
 	
-	LCDPORT |= LCD_DC_A0;     //Data
-	 
-    LCDPORT &= ~(LCD_CS);     //CS=0
+	si5351_calc_regs(f_vfo[cur_band][0] + f_lo[sideband] + rit, regs[0]);
+	si5351_calc_regs(f_vfo[cur_band][1] + f_lo[sideband] + rit, regs[1]);
 	
-	for(t1 = 7; t1 >= 0; t1--)
-    {
-	    LCDPORT &= ~(LCD_CLOCK);  //SCL=0	
-	    if(dvalue & (1 << t1))
-	    {
-		    LCDPORT |= LCD_DATA;
-	    }
-	    else
-	    {
-		    LCDPORT &= ~(LCD_DATA); 
-	    }
-	    LCDPORT |= LCD_CLOCK;  //SCL=1		
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(3 * FONTWIDTH, FONTHEIGHT, PSTR("DUAL WATCH"), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putnumber(2 * FONTWIDTH, 3 * FONTHEIGHT, f_vfo[cur_band][0] / 100, 1, WHITE, backcolor, 1, 1);
+	lcd_putnumber(2 * FONTWIDTH, 5 * FONTHEIGHT, f_vfo[cur_band][1] / 100, 1, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(5 * FONTWIDTH, 7 * FONTHEIGHT, PSTR("hops/s"), WHITE, backcolor, 1, 1);	
+	dw_show_times(edit);
+	t_disp = t_rate = get_ms();
+	
+	while(1)
+	{
+		t0 = get_ms();
+		if(side != on)
+		{
+			si5351_write_regs(SYNTH_MS_1, regs[side]);
+			on = side;
+			hops++;
+			while(get_ms() - t0 < dw_settle);
+		}
+		smeter_reset();
+		while(get_ms() - t0 < dw_dwell);
+		
+		sval[side] = get_s_value();
+		noise_update(sval[side]);
+		
+		if(latch < 0)
+		{
+			if(sval[side] > squelch_level())
+			{
+				latch = side;
+				runsecs10latch = runseconds10;
+			}
+			else
+			{
+				side ^= 1;
+			}
+		}
+		else
+		{
+			if(sval[side] > squelch_level() - SQ_HYST)
+			{
+				runsecs10latch = runseconds10;
+			}
+			if(runsecs10latch + 30 < runseconds10)
+			{
+				latch = -1;
+				side ^= 1;
+			}
+		}
+		
+		if(get_ms() - t_rate >= 1000)
+		{
+			hops_s = hops;
+			hops = 0;
+			t_rate += 1000;
+		}
+		
+		if(get_ms() - t_disp >= SCAN_REFRESH)
+		{
+			lcd_putchar(0, 3 * FONTHEIGHT, 'A', (latch == 0) ? backcolor : LIGHTYELLOW, (latch == 0) ? LIGHTYELLOW : backcolor, 1, 1);
+			lcd_putchar(0, 5 * FONTHEIGHT, 'B', (latch == 1) ? backcolor : LIGHTYELLOW, (latch == 1) ? LIGHTYELLOW : backcolor, 1, 1);
+			dw_bar(4 * FONTHEIGHT + 4, smeter_db2px(sval[0]), (latch == 0) ? LIGHTRED : LIGHTGREEN);
+			dw_bar(6 * FONTHEIGHT + 4, smeter_db2px(sval[1]), (latch == 1) ? LIGHTRED : LIGHTGREEN);
+			lcd_putnumber_r(0, 7 * FONTHEIGHT, hops_s, -1, 4, WHITE, backcolor, 1, 1);
+			t_disp = get_ms();
+		}
+		
+		//Dwell 10..250ms, settle 1..20ms, dwell leaves at least 2ms for sampling
+		if(tuningknob > 2 || tuningknob < -2)
+		{
+			if(edit)
+			{
+				dw_settle += (tuningknob > 0) ? 1 : -1;
+				if(dw_settle < 1)
+				{
+					dw_settle = 1;
+				}
+				if(dw_settle > 20)
+				{
+					dw_settle = 20;
+				}
+			}
+			else
+			{
+				dw_dwell += (tuningknob > 0) ? 5 : -5;
+				if(dw_dwell > 250)
+				{
+					dw_dwell = 250;
+				}
+			}
+			if(dw_dwell < 10)
+			{
+				dw_dwell = 10;
+			}
+			if(dw_dwell < dw_settle + 2)
+			{
+				dw_dwell = dw_settle + 2;
+			}
+			tuningknob = 0;
+			dw_show_times(edit);
+		}
+		
+		key = get_keys();
+		if(ptt_tx)
+		{
+			key = (latch < 0) ? 3 : 2;
+		}
+		switch(key)
+		{
+			case 1: edit ^= 1;
+			        dw_show_times(edit);
+			        break;
+			case 2: if(on != cur_vfo)
+			        {
+						select_vfo(on);
+					}
+					else
+					{
+						set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+					}
+			        return;
+			case 3: set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+			        return;
+		}
+	}
+}	
+
+//////////////////////
+//
+//  H I T S
+//
+/////////////////////
+//Record scan stop in hit ring and activity histogram of current band
+void hit_add(long f, int sval)
+{
+	int bin = ((f - band_f0[cur_band]) * HIST_BINS) / (band_f1[cur_band] - band_f0[cur_band]);
+	
+	hit_f[hit_pos] = f;
+	hit_s[hit_pos] = sval;
+	hit_t[hit_pos] = runseconds10 / 10;
+	hit_pos = (hit_pos + 1) & (HITS - 1);
+	if(hit_cnt < HITS)
+	{
+		hit_cnt++;
+	}
+	
+	if(bin < 0)
+	{
+		bin = 0;
+	}
+	if(bin > HIST_BINS - 1)
+	{
+		bin = HIST_BINS - 1;
+	}
+	if(hist[cur_band][bin] < 255)
+	{
+		hist[cur_band][bin]++;
+	}
+}	
+
+//Set VFO to f, band is changed if necessary
+void hit_tune(long f)
+{
+	int t1;
+	
+	for(t1 = 0; t1 < MAXBANDS; t1++)
+	{
+		if(is_band_freq(f, t1) && t1 != cur_band)
+		{
+			cur_band = t1;
+			sideband = std_sideband[cur_band];
+			set_band(cur_band); //Relays and LO of new sideband
+			mcp4725_set_value(tx_preset[cur_band]);
+		}
+	}
+	f_vfo[cur_band][cur_vfo] = f;
+	set_vfo(f + f_lo[sideband]);
+}	
+
+//Browse hits from newest to oldest with rotary encoder, VFO follows.
+//Key 2 keeps frequency, any other key restores old one. ui_pos = hit number
+void hits_open(void)
+{
+	if(!hit_cnt)
+	{
+		show_msg_P(PSTR("No hits."));
+		return;
+	}
+	ui_old = f_vfo[cur_band][cur_vfo];
+	store_frequency(cur_vfo, cur_band, ui_old); //Leaving band
+	
+	ui_screen = UI_HITS;
+	ui_pos = 1;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(4 * FONTWIDTH, FONTHEIGHT, PSTR("SCAN HITS"), WHITE, LIGHTBLUE, 1, 1);	
+	hits_show(ui_pos);
+}	
+
+//Tune to hit n (1 = newest) and show it
+void hits_show(int n)
+{
+	int idx = (hit_pos - n) & (HITS - 1);
+	
+	hit_tune(hit_f[idx]);
+	
+	lcd_putstring_P(0, 3 * FONTHEIGHT, blank_str, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(0, 5 * FONTHEIGHT, blank_str, WHITE, backcolor, 1, 1);
+	lcd_putchar(4 * FONTWIDTH, 3 * FONTHEIGHT, '#', YELLOW, backcolor, 1, 1);
+	lcd_putnumber(5 * FONTWIDTH, 3 * FONTHEIGHT, n, -1, YELLOW, backcolor, 1, 1);
+	lcd_putnumber(4 * FONTWIDTH, 4 * FONTHEIGHT, hit_f[idx] / 100, 1, WHITE, backcolor, 1, 1);
+	lcd_putchar(0, 5 * FONTHEIGHT, 'S', WHITE, backcolor, 1, 1);
+	lcd_putnumber(2 * FONTWIDTH, 5 * FONTHEIGHT, hit_s[idx], -1, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(5 * FONTWIDTH, 5 * FONTHEIGHT, PSTR("dB"), WHITE, backcolor, 1, 1);
+	lcd_putnumber(9 * FONTWIDTH, 5 * FONTHEIGHT, runseconds10 / 10 - hit_t[idx], -1, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(14 * FONTWIDTH, 5 * FONTHEIGHT, PSTR("s"), WHITE, backcolor, 1, 1);
+}	
+
+//Turn CW: older hit, CCW: newer hit
+void hits_event(int key, int dir)
+{
+	if(dir)
+	{
+		ui_pos += dir;
+		if(ui_pos > hit_cnt)
+		{
+			ui_pos = 1;
+		}
+		if(ui_pos < 1)
+		{
+			ui_pos = hit_cnt;
+		}
+		hits_show(ui_pos);
+	}
+	
+	if(!key)
+	{
+		return;
+	}
+	if(key == 2)
+	{
+		store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
+	}
+	else
+	{
+		hit_tune(ui_old);
+	}
+	ui_close();
+}	
+
+//Draw hit counts per frequency bin of current band as bar graph
+void hist_open(void)
+{
+	int t1, t2, h, hmax = 0;
+	
+	ui_screen = UI_VIEW;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(2 * FONTWIDTH, FONTHEIGHT, PSTR("ACTIVITY"), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(11 * FONTWIDTH, FONTHEIGHT, band_str[cur_band], WHITE, LIGHTBLUE, 1, 1);	
+	
+	for(t1 = 0; t1 < HIST_BINS; t1++)
+	{
+		if(hist[cur_band][t1] > hmax)
+		{
+			hmax = hist[cur_band][t1];
+		}
+	}
+	
+	if(!hmax)
+	{
+		lcd_putstring_P(5 * FONTWIDTH, 4 * FONTHEIGHT, PSTR("Empty."), WHITE, backcolor, 1, 1);
+	}
+	else
+	{
+		for(t1 = 0; t1 < HIST_BINS; t1++)
+		{
+			h = hist[cur_band][t1] * HIST_HEIGHT / hmax;
+			if(h)
+			{
+				lcd_setwindow(t1 * 8, HIST_BOTTOM - h + 1, t1 * 8 + 5, HIST_BOTTOM);
+				lcd_write_command(ST7735_RAMWR);
+				for(t2 = 0; t2 < h * 6; t2++)
+				{
+					lcd_write_data(GREEN >> 8);
+					lcd_write_data(GREEN & 0xFF);
+				}
+			}
+		}
+	}
+	
+	//Band edges in kHz
+	lcd_putnumber(0, 8 * FONTHEIGHT, band_f0[cur_band] / 1000, -1, WHITE, backcolor, 1, 1);
+	lcd_putnumber(11 * FONTWIDTH, 8 * FONTHEIGHT, band_f1[cur_band] / 1000, -1, WHITE, backcolor, 1, 1);
+}	
+
+//Histogram, cross-band summary: any key returns to main screen
+void view_event(int key, int dir)
+{
+	if(key)
+	{
+		ui_close();
+	}
+}	
+
+//Margin of scan squelch above noise floor in dB, meter shows resulting level
+void thresh_open(void)
+{
+    const char *s = PSTR("SCAN THRESH...");
+	int xpos0 = (16 - strlen_P(s)) / 2;
+	int ypos0 = 1;
+    
+	ui_screen = UI_THRESH;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, ypos0 * FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, s, WHITE, LIGHTBLUE, 1, 1);	
+	
+    draw_meter_scale(0);
+    sv_old = 0;
+    thresh_event(0, 0);
+}
+
+//Encoder sets thresh 0..12, key 2 stores, other keys restore stored value
+void thresh_event(int key, int dir)
+{
+	thresh += dir;
+	if(thresh > 12)
+	{
+		thresh = 12;
+	}
+	if(thresh < 0)
+	{
+		thresh = 0;
+	}
+	
+	if(!key)
+	{
+		show_meter(smeter_db2px(squelch_level()));
+	    lcd_putstring_P(5 * FONTWIDTH, 4 * FONTHEIGHT, PSTR("    "), WHITE, backcolor, 1, 1);
+        lcd_putnumber(5 * FONTWIDTH, 4 * FONTHEIGHT, thresh, -1, WHITE, backcolor, 1, 1);
+        return;
+	}
+	
+	if(key == 2)
+	{
+		CONFIG_SAVE(thresh, thresh);
 	}	
-	LCDPORT |= LCD_CS;        //CS=1
+	else
+	{
+		thresh = cfg.thresh;
+	}
+	ui_close();
+}
+
+//////////////////////
+//
+// RADIO CONTROl
+//
+/////////////////////
+void set_band(int bcode)
+{
+	band_relays(bcode);
+	if(bcode >= 0)
+	{
+		show_sideband(std_sideband[bcode], 0);
+	}
+}	
+
+//Band relays and LO of preferred sideband, display is left alone
+void band_relays(int bcode)
+{
+	int t1 = 0;
+    
+    //RESET PORTB relay bcd decoder
+    PORTD &= ~(1 << PD0);
+    PORTD &= ~(1 << PD1);
+    PORTD &= ~(1 << PD2);
+	
+	if(bcode < 0) //Return if RESET-Mode has been selected
+	{
+		return;
+	}
+		
+	for(t1 = 0; t1 < 3; t1++)
+	{
+	   if(bcode & (1 << t1))
+	   {
+		    PORTD |= (1 << t1);  
+	   }	 
+	   else
+	   {	 
+           PORTD &= ~(1 << t1);
+       }
+    }   
+    
+    //Set LO to preferred sideband of new ham band
+    set_lo(std_sideband[bcode]);
+}	
+
+//Check if freq is in 20m-band
+int is_band_freq(long f, int cband)
+{
+	
+	if(f >= band_f0[cband] && f <= band_f1[cband])
+	{
+	    return 1;
+	}	
+	else
+	{
+	    return 0;
+	}		
+}
+
+//Calc new frequency from rotary encoder
+long tune_frequency(long fx)
+{
+	long f = fx;
+	
+	//Manual tuning	
+	if(tuningknob > 2)  
+	{    
+		f += calc_tuningfactor();
+		tuningknob = 0;
+		return f;
+	}
+		
+	if(tuningknob < -2)
+	{
+		f -= calc_tuningfactor();
+		tuningknob = 0;
+		return f;
+	}
+	return 0;
+}	
+
+//Switch RX ATT on or off
+void set_att(int status)
+{
+	if(status)
+	{
+		PORTB |= (1 << PB2);
+	}
+	else
+	{
+		PORTB &= ~(1 << PB2);
+	}	
+}	
+
+//Switch AGC fast or slow
+void set_agc(int status)
+{
+	if(status)
+	{
+		PORTB &= ~(1 << PB4);
+	}
+	else
+	{
+		PORTB |= (1 << PB4);
+	}	
+}	
+
+//Switch AGC fast or slow
+void set_tone(int status)
+{
+	if(status)
+	{
+		PORTB &= ~(1 << PB5);
+	}
+	else
+	{
+		PORTB |= (1 << PB5);
+	}	
+}	
+
+//RIT (mode = 0) or XIT (mode = 1) offset is adjusted on main screen,
+//so meters and PTT keep running. ui_pos = mode, ui_val = old offset
+void ritxit_open(int mode)
+{
+	ui_close();
+	ui_screen = UI_RITXIT;
+	ui_pos = mode;
+	ui_val = mode ? xit : rit;
+	ritxit_event(0, 0);
+}
+
+//Encoder steps 10Hz, key 2 keeps new value, other keys restore old one
+void ritxit_event(int key, int dir)
+{
+	int *offset = ui_pos ? &xit : &rit;
+	
+	if(dir > 0 && *offset < RITMAX) //Turn CW
+	{
+		*offset += 10;
+	}
+	if(dir < 0 && *offset > -RITMAX) //Turn CCW
+	{
+		*offset -= 10;
+	}
+	if(key && key != 2)
+	{
+		*offset = ui_val;
+	}
+	
+	//Only changed Si5351 registers are sent, TX with split is on the other VFO
+	set_vfo(f_vfo[cur_band][cur_vfo ^ (split & txrx)] + f_lo[sideband]);
+	show_ritxit();
+	
+	if(key)
+	{
+		ui_screen = UI_MAIN;
+		return;
+	}
+	show_msg_P(ritxit_str[ui_pos]);
+	lcd_putnumber(11 * FONTWIDTH, 8 * FONTHEIGHT, *offset, -1, WHITE, backcolor, 1, 1);
+}
+
+///////////////////////////
+//
+//         TWI
+//
+///////////////////////////
+void twi_init(void)
+{
+    //set SCL to 400kHz
+    TWSR = 0x00;
+    TWBR = 0x0C;
+	
+    //enable TWI
+    TWCR = (1<<TWEN);
+}
+
+//Send start signal
+void twi_start(void)
+{
+    TWCR = (1<<TWINT)|(1<<TWSTA)|(1<<TWEN);
+    while ((TWCR & (1<<TWINT)) == 0);
+}
+
+//send stop signal
+void twi_stop(void)
+{
+    TWCR = (1<<TWINT)|(1<<TWSTO)|(1<<TWEN);
+}
+
+void twi_write(uint8_t u8data)
+{
+    TWDR = u8data;
+    TWCR = (1<<TWINT)|(1<<TWEN);
+    while ((TWCR & (1<<TWINT)) == 0);
+}
+
+  ///////////////////////
+ //       L C D       //
+///////////////////////    
+//Perform hardware reset to LCD
+void lcd_reset(void)
+{
+	LCDPORT |= LCD_RST;  
+	_delay_ms(100);
+	LCDPORT &= ~(LCD_RST);  
+	_delay_ms(100);
+	LCDPORT |= LCD_RST;  
+	_delay_ms(100);
+}	
+
+//Write command to LCD
+void lcd_write_command(int cmd)
+{
+	int t1;
+	
+	LCDPORT &= ~(LCD_DC_A0);  //Command
+	 
+    LCDPORT &= ~(LCD_CS);     //CS=0
+	
+	for(t1 = 7; t1 >= 0; t1--)
+    {
+	    LCDPORT &= ~(LCD_CLOCK);  //SCL=0	
+	    if(cmd & (1 << t1))
+	    {
+		    LCDPORT |= LCD_DATA;
+	    }
+	    else
+	    {
+		    LCDPORT &= ~(LCD_DATA); 
+	    }
+	    LCDPORT |= LCD_CLOCK;  //SCL=1		
+	}	
+	LCDPORT |= LCD_CS;        //CS=1
+}	
+
+//Write data to LCD
+void lcd_write_data(int dvalue)
+{
+	int t1;
+	
+	LCDPORT |= LCD_DC_A0;     //Data
+	 
+    LCDPORT &= ~(LCD_CS);     //CS=0
+	
+	for(t1 = 7; t1 >= 0; t1--)
+    {
+	    LCDPORT &= ~(LCD_CLOCK);  //SCL=0	
+	    if(dvalue & (1 << t1))
+	    {
+		    LCDPORT |= LCD_DATA;
+	    }
+	    else
+	    {
+		    LCDPORT &= ~(LCD_DATA); 
+	    }
+	    LCDPORT |= LCD_CLOCK;  //SCL=1		
+	}	
+	LCDPORT |= LCD_CS;        //CS=1
+}	
+
+
+//Init LCD to vertical alignement and 16-bit color mode
+void lcd_init(void)
+{
+
+	lcd_write_command(ST7735_SWRESET); // software reset
+	_delay_ms(5);
+
+	lcd_write_command(ST7735_SLPOUT);  // out of sleep mode
+	_delay_ms(5);
+
+	lcd_write_command(ST7735_COLMOD);  // set color mode
+	lcd_write_data(0x05);              // 16-bit color
+	_delay_ms(10);
+
+	lcd_write_command(ST7735_FRMCTR1); // frame rate control
+	lcd_write_data(0x00);              // fastest refresh
+	lcd_write_data(0x06);              // 6 lines front porch
+	lcd_write_data(0x03);              // 3 lines backporch
+	_delay_ms(1);
+
+	lcd_write_command(ST7735_MADCTL);  // memory access control (directions)
+	lcd_write_data(0xC8);              // row address/col address, bottom to top refresh
+
+	lcd_write_command(ST7735_DISSET5); // display settings #5
+	lcd_write_data(0x15);              // 1 clock cycle nonoverlap, 2 cycle gate rise, 3 cycle oscil. equalize
+	lcd_write_data(0x02);              // fix on VTL
+
+	lcd_write_command(ST7735_INVCTR);  // display inversion control
+	lcd_write_data(0x0);               // line inversion
+
+	lcd_write_command(ST7735_GMCTRP1);
+	lcd_write_data(0x09);
+	lcd_write_data(0x16);
+	lcd_write_data(0x09);
+	lcd_write_data(0x20);
+	lcd_write_data(0x21);
+	lcd_write_data(0x1B);
+	lcd_write_data(0x13);
+	lcd_write_data(0x19);
+	lcd_write_data(0x17);
+	lcd_write_data(0x15);
+	lcd_write_data(0x1E);
+	lcd_write_data(0x2B);
+	lcd_write_data(0x04);
+	lcd_write_data(0x05);
+	lcd_write_data(0x02);
+	lcd_write_data(0x0E);
+
+	lcd_write_command(ST7735_GMCTRN1);
+	lcd_write_data(0x0B);
+	lcd_write_data(0x14);
+	lcd_write_data(0x08);
+	lcd_write_data(0x1E);
+	lcd_write_data(0x22);
+	lcd_write_data(0x1D);
+	lcd_write_data(0x18);
+	lcd_write_data(0x1E);
+	lcd_write_data(0x1B);
+	lcd_write_data(0x1A);
+	lcd_write_data(0x24);
+	lcd_write_data(0x2B);
+	lcd_write_data(0x06);
+	lcd_write_data(0x06);
+	lcd_write_data(0x02);
+	lcd_write_data(0x0F);
+	_delay_ms(10);
+	
+	lcd_write_command(ST7735_NORON);   // Normal display on
+	_delay_ms(10);
+
+	lcd_write_command(ST7735_DISPON);  //Display ON
+}	
+
+//Define window area for next graphic operation
+void lcd_setwindow(int x0, int y0, int x1, int y1)
+{
+	lcd_write_command(ST7735_CASET);   //Coloumn address set
+	lcd_write_data(0x00);
+	lcd_write_data(x0);          
+	lcd_write_data(0x00);
+	lcd_write_data(x1);          
+
+	lcd_write_command(ST7735_RASET);   //Row address set
+	lcd_write_data(0x00);
+	lcd_write_data(y0);        
+	lcd_write_data(0x00);
+	lcd_write_data(y1);        
+}
+
+//Set a pixel (Not used, just for academic purposes!)
+void lcd_setpixel(int x, int y, unsigned int color)
+{
+	lcd_setwindow(x, y, x, y);
+	lcd_write_command(ST7735_RAMWR);		// RAM access set
+	lcd_write_data(color >> 8);
+	lcd_write_data(color);
+}
+
+//Clear full LCD with background color
+void lcd_cls0(unsigned int bgcolor)
+{
+	int t1;
+	lcd_setwindow(0, 0, 132, 132);
+	lcd_write_command(ST7735_RAMWR);		// RAM access set
+		
+    for(t1 = 0; t1 <= 17424; t1++)
+    {
+		lcd_write_data(bgcolor >> 8);
+	    lcd_write_data(bgcolor);
+	}    
+}	
+
+//Clear part of LCD with background color
+void lcd_cls1(int x0, int y0, int x1, int y1, unsigned int bgcolor)
+{
+	int t1, sz = (x1 - x0) * (y1 - y0);
+	lcd_setwindow(x0, y0, x1, y1);
+	lcd_write_command(ST7735_RAMWR);		// RAM access set
+		
+    for(t1 = 0; t1 <= sz; t1++)
+    {
+		lcd_write_data(bgcolor >> 8);
+	    lcd_write_data(bgcolor);
+	}    
+}	
+
+//Print one character to given coordinates to the screen
+//sx and sy define "stretch factor"
+void lcd_putchar(int x0, int y0, unsigned char ch0, unsigned int fcol, unsigned int bcol, int sx, int sy)
+{
+	int x, y, t1, t2;
+	unsigned char ch;
+	
+    lcd_setwindow(x0 + 2, y0 + 2, x0 + FONTWIDTH * sx + 1, y0 + FONTHEIGHT * sy);
+	lcd_write_command(ST7735_RAMWR);
+	
+	for(y = 0; y < FONTHEIGHT - 1; y++)
+	{
+		ch = pgm_read_byte(&xchar[ch0 - CHAROFFSET][y]); 
+	    for(t1 = 0; t1 < sy; t1++)
+	    {
+	        for(x = 0; x < FONTWIDTH; x++)
+	        {
+		        if((1 << x) & ch)
+		        {
+					for(t2 = 0; t2 < sx; t2++)
+					{
+			            lcd_write_data(fcol >> 8);
+			            lcd_write_data(fcol);
+			        }    
+			    }
+	   	        else	
+		        {
+					for(t2 = 0; t2 < sx; t2++)
+					{
+			            lcd_write_data(bcol >> 8);
+			            lcd_write_data(bcol);
+			        }    
+			    }   
+		    }
+	    }	
+	}
+}	
+
+//Print one \0 terminated string in flash to given coordinates to the screen
+//xf and yf define "stretch factor"
+void lcd_putstring_P(int x0, int y0, const char *s, unsigned int fcol, unsigned int bcol, int xf, int yf)
+{
+	int x = 0;
+	char ch;
+	
+	while((ch = pgm_read_byte(s++)))
+	{
+		lcd_putchar(x + x0, y0, ch, fcol, bcol, xf, yf);
+		x += (FONTWIDTH * xf);
+	}	
+}
+
+void lcd_putstring2_P(int x0, int y0, const char *s, unsigned int fcol, unsigned int bcol, int xf)
+{
+	int x = 0;
+	char ch;
+	
+	while((ch = pgm_read_byte(s++)))
+	{
+		lcd_putchar(x + x0, y0, ch, fcol, bcol, 1, 1);
+		x += (FONTWIDTH + xf);
+	}	
+}
+
+//Print a number
+//xf and yf define "stretch factor"
+int lcd_putnumber(int col, int row, long num, int dec, int fcolor, int bcolor, int xf, int yf)
+{
+	return lcd_putnumber_r(col, row, num, dec, 0, fcolor, bcolor, xf, yf);
+}
+
+//Print a number right aligned in a field of width chars (0 = no padding)
+//Digits are found by subtracting powers of ten and every glyph goes to
+//the LCD as soon as it is known, so no string buffer and no division.
+//dec = number of decimal places, 0 is printed as "0" without decimals like
+//the old int2asc() did, returns number of chars printed
+int lcd_putnumber_r(int col, int row, long num, int dec, int width, int fcolor, int bcolor, int xf, int yf)
+{
+	unsigned long n, p;
+	int t1, first, point, len, dot = 0;
+	char ch;
+	
+	n = (num < 0) ? -num : num;
+	point = (dec > 0 && n) ? 9 - dec : 10; //Index of digit followed by '.'
+	
+	//Find leading digit, keep at least one digit in front of the point
+	first = 0;
+	while(first < 9 && first < point && n < pgm_read_dword(&pow10_tab[first]))
+	{
+		first++;
+	}	
+	len = 10 - first + (point < 10) + (num < 0);
+	if(width < len)
+	{
+		width = len;
+	}
+	
+	//One glyph per pass (padding, sign, digits and point), so there is
+	//only one lcd_putchar() call to pay for in flash
+	for(t1 = width; t1 > 0; t1--)
+	{
+		if(t1 > len)
+		{
+			ch = ' ';
+		}
+		else if(t1 == len && num < 0)
+		{
+			ch = '-';
+		}
+		else if(dot)
+		{
+			ch = '.';
+			dot = 0;
+		}
+		else
+		{
+			p = pgm_read_dword(&pow10_tab[first]);
+			ch = '0';
+			while(n >= p)
+			{
+				n -= p;
+				ch++;
+			}
+			dot = (first++ == point);
+		}
+		lcd_putchar(col, row, ch, fcolor, bcolor, xf, yf);
+		col += (FONTWIDTH * xf);
+	}
+	
+	return width;
+}
+
+//////////////////////////////////
+//
+//  DATA DISPLAY FUNCTIONS
+//
+//////////////////////////////////
+
+void show_all_data(long f, int cband, int s, int vfo, int volts, int mtr_scale, int split_state)
+{
+	int t1;
+	int y0 = 36;
+	int y1 = y0 + 10 + 2 * FONTHEIGHT;
+	
+	lcd_cls0(backcolor);	
+	
+	for(t1 = 0; t1 < 16; t1++)
+	{
+		lcd_putchar(t1 * FONTWIDTH, y0, 0x83, YELLOW, backcolor, 1, 1);
+		lcd_putchar(t1 * FONTWIDTH, y1, 0x83, YELLOW, backcolor, 1, 1);
+	}	
+	show_frequency1(f, 2); 
+	show_band(cband, 0);
+	show_sideband(s, 0);
+	show_vfo(vfo, 0);
+	show_voltage(volts);
+	show_tone(cur_tone);
+	draw_meter_scale(mtr_scale);
+	show_split(split_state, backcolor);
+	show_att(rx_att);
+	show_agc(agc);
+	show_ritxit();
+}   
+
+void show_frequency1(long f, int csize)
+{
+	int x;
+	int y = 50;
+	int fcolor;
+	
+	if(is_band_freq(f, cur_band))
+	{
+		fcolor = WHITE;
+	}
+	else	
+	{
+		fcolor = LIGHTRED;
+	}
+	
+	if(f < 10000000)
+	{
+		x = 128 - FONTWIDTH * 12 - 5;
+	}
+	else
+	{
+		x = 128 - FONTWIDTH * 14 - 5;
+	}	
+	
+	if(f == 0)
+	{
+	    lcd_putstring_P(0, y, PSTR("       "), backcolor, backcolor, csize, csize);
+	}
+	else
+	{
+		if(csize == 1)
+		{
+		    lcd_putnumber(x, y, f, 3, fcolor, backcolor, csize, csize);
+		}    
+		else
+		{
+		    lcd_putnumber(x, y, f / 100, 1, fcolor, backcolor, csize, csize);
+		}
+	}	    
+
+}
+
+void show_frequency2(long f)
+{
+	int xpos, ypos = 2 * FONTHEIGHT;
+	
+	if(f < 10000000)
+	{
+		xpos = 10 * FONTWIDTH;
+	}
+	else
+	{
+		xpos = 9 * FONTWIDTH;
+	}	
+	
+	lcd_putstring_P(9 * FONTWIDTH, ypos, PSTR("       "), WHITE, backcolor, 1, 1);
+	lcd_putnumber(xpos, ypos, f / 100, 1, WHITE, backcolor, 1, 1);
+}
+
+void show_band(int band, int invert)
+{
+	int xpos = 0, ypos = 0;	 
+	int forecolor = WHITE;
+	
+	switch(band)
+	{
+		case 0: forecolor = LIGHTBLUE;
+		        break;
+		case 1: forecolor = LIGHTBROWN;
+		        break;
+		case 2: forecolor = LIGHTGREEN;
+		        break;
+		case 3: forecolor = LIGHTGRAY;
+		        break;
+		case 4: forecolor = LIGHTVIOLET2;
+		        break;
+	}	        
+	
+	if(invert)
+	{	
+	     lcd_putstring_P(xpos, ypos, band_str[band], backcolor, forecolor, 1, 1);
+	}
+	else     
+	{	
+	     lcd_putstring_P(xpos, ypos, band_str[band], forecolor, backcolor, 1, 1);
+	}
+}
+
+void show_sideband(int sb, int invert)
+{
+	int xpos = 4 * FONTWIDTH, ypos = 0;
+	
+	if(invert)
+	{
+		//Write string to position
+	    lcd_putstring_P(xpos * 6, ypos, sb_str[sb], backcolor, LIGHTBLUE, 1, 1);
+	}
+	else
+	{
+		//Write string to position
+	    lcd_putstring_P(xpos, ypos, sb_str[sb], LIGHTBLUE, backcolor, 1, 1);
+	}
+	   
+}
+
+void show_split(int splt, int invert)
+{
+	int xpos = 0 * FONTWIDTH, ypos = 2 * FONTHEIGHT;
+	int splitcolor[] = {LIGHTGRAY, LIGHTRED};
+	//Write string to position
+	lcd_putstring_P(xpos, ypos, PSTR("SPLT"), splitcolor[splt], backcolor, 1, 1);
+	   
+}
+
+void show_vfo(int vfo, int invert)
+{
+	int xpos = 8 * FONTWIDTH, ypos = 0;
+	
+	//Show frequency of other VFO in d
+	if(!vfo)	
+	{
+		show_frequency2(f_vfo[cur_band][1]);
+	}
+	else	
+	{
+		show_frequency2(f_vfo[cur_band][0]);
+	}
+	
+	//Write string to position
+	lcd_putstring_P(xpos, ypos, vfo_str[vfo], YELLOW, backcolor, 1, 1);
+}
+
+
+void show_pa_temp(void)
+{
+	int xpos = 12 * FONTWIDTH, ypos = FONTHEIGHT;
+	int tmp = get_pa_temp();
+	int fcolor = LIGHTGREEN;
+	
+	if(tmp > 40)
+	{
+		fcolor = LIGHTYELLOW;
+	}	
+	
+	if(tmp > 60)
+	{
+		fcolor = LIGHTRED;
+	}	
+	
+	xpos = (12 + lcd_putnumber(xpos, ypos, tmp, -1, fcolor, backcolor, 1, 1)) * FONTWIDTH;
+	lcd_putchar(xpos, ypos, 0x88, fcolor, backcolor, 1, 1); //-sign
+	xpos += FONTWIDTH;
+	lcd_putchar(xpos, ypos, 'C', fcolor, backcolor, 1, 1); //C
+}
+
+void show_att(int status)
+{
+	int xpos = 5 * FONTWIDTH, ypos = 2 * FONTHEIGHT;
+
+
+    int fcolor;
+    	
+	if(!status)
+	{
+		fcolor = LIGHTGRAY;
+	}
+	else
+	{
+		fcolor = LIGHTYELLOW;
+	}	
+
+	lcd_putstring_P(xpos, ypos, PSTR("ATT"), fcolor, backcolor, 1, 1);
+}
+
+void show_agc(int status)
+{
+	int xpos = 6 * FONTWIDTH, ypos = FONTHEIGHT;
+	
+    int fcolor;
+    	
+	if(status)
+	{
+		fcolor = LIGHTYELLOW;
+		lcd_putstring_P(xpos, ypos, PSTR("SLOW"), fcolor, backcolor, 1, 1);
+	}
+	else
+	{
+	    fcolor = YELLOW;	
+		lcd_putstring_P(xpos, ypos, PSTR("FAST"), fcolor, backcolor, 1, 1);
+	}	
+}
+	
+//RIT/XIT indicator between VFO and TONE
+void show_ritxit(void)
+{
+	int xpos = 12 * FONTWIDTH, ypos = 0;
+	
+	if(rit)
+	{
+		lcd_putchar(xpos, ypos, 'R', LIGHTRED, backcolor, 1, 1);
+	}
+	else
+	{
+		lcd_putchar(xpos, ypos, ' ', LIGHTRED, backcolor, 1, 1);
+	}
+	
+	if(xit)
+	{
+		lcd_putchar(xpos + FONTWIDTH, ypos, 'X', LIGHTRED, backcolor, 1, 1);
+	}
+	else
+	{
+		lcd_putchar(xpos + FONTWIDTH, ypos, ' ', LIGHTRED, backcolor, 1, 1);
+	}
+}
+	
+void show_voltage(int v1)
+{
+	int p;
+	int xpos = 0, ypos = FONTHEIGHT;
+	int fcolor;
+		
+    if(v1 < 10)
+    {
+		fcolor = RED;
+	}
+	
+	if(v1 >= 10 && v1 < 11)
+    {
+		fcolor = LIGHTRED;
+	}	
+	
+	if(v1 >= 11 && v1 < 13)
+    {
+		fcolor = GREEN;
+	}	
+	
+	if(v1 >= 13)
+    {
+		fcolor = LIGHTGREEN;
+	}	
+	
+    p = lcd_putnumber(xpos, ypos, v1, 1, fcolor, backcolor, 1, 1) * FONTWIDTH + xpos;
+	lcd_putstring_P(p, ypos, PSTR("V "), fcolor, backcolor, 1, 1);
+}
+
+void show_tone(int status)
+{
+	int xpos = 14 * FONTWIDTH, ypos = 0;
+		
+	//Write string to position
+	if(!status)
+	{
+	    lcd_putstring_P(xpos, ypos, PSTR("LO"), YELLOW, backcolor, 1, 1);
+	}
+	else    
+	{
+	    lcd_putstring_P(xpos, ypos, PSTR("HI"), YELLOW2, backcolor, 1, 1);
+	}
+}	
+
+//Message line, string in flash
+void show_msg_P(const char *msg)
+{	
+	int xpos = 0, ypos = 8 * FONTHEIGHT;
+	lcd_putstring_P(xpos, ypos, blank_str, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(xpos, ypos, msg, WHITE, backcolor, 1, 1);
+	runseconds10msg = runseconds10;
+	msgstatus = 1;
+}	
+
+//S-Meter bargraph 
+void draw_meter_bar(int x0, int x1, int fcol)
+{
+	int t1;
+	
+	lcd_setwindow(x0 + 2, 90, x1 + 2, 94);
+	lcd_write_command(ST7735_RAMWR);
+	for(t1 = 0; t1 < ((x1 - x0) << 2) + 4; t1++)
+	{
+		lcd_write_data(fcol >> 8);
+	    lcd_write_data(fcol);
+	}
+}	
+
+//Draw bar graph x0..x1 in the colors of the meter scale
+void draw_meter_segment(int x0, int x1)
+{
+	if(x0 <= 65)
+	{
+		if(x1 < 65)
+		{
+	        draw_meter_bar(x0, x1, GREEN);
+	    }
+	    else
+	    {
+			draw_meter_bar(x0, 65, GREEN);
+		}
+	}
+	
+	if(x1 > 65 && x0 <= 89)
+	{
+		draw_meter_bar((x0 > 66) ? x0 : 66, (x1 < 89) ? x1 : 89, LIGHTYELLOW);
+	}
+	
+	if(x1 > 89)
+	{
+		draw_meter_bar((x0 > 90) ? x0 : 90, x1, LIGHTRED);
+	}
+}	
+
+//Bar graph 0..sv0, only the difference to the last bar is drawn
+void show_meter(int sv0)
+{
+    int sv = sv0;
+    
+    if(sv > 120)
+    {
+		sv = 120;
+	}	
+	
+	if(sv < 0)
+	{
+		sv = 0;
+	}	
+	
+	if(sv > sv_old)
+	{
+		draw_meter_segment(sv_old, sv - 1);
+	}
+	
+	if(sv < sv_old)
+	{
+		draw_meter_bar(sv, sv_old - 1, backcolor);
+	}
+		
+	sv_old = sv;   
+}
+
+//S-Meter from filter stage: bar = smoothed level, marker = peak hold
+void show_smeter(void)
+{
+	int sv_prev = sv_old;
+	int sv = smeter_db2px(get_s_value());
+	int pk = smeter_db2px(get_s_peak());
+	
+	show_meter(sv);
+	sv = sv_old; //Clipped
+	
+	if(pk > 119)
+	{
+		pk = 119;
+	}
+	
+	//Move marker, or restore it if bar has just been cleared over it
+	if(pk != smax || (sv < sv_prev && pk >= sv && pk < sv_prev))
+	{
+		if(smax >= sv)
+		{
+		    draw_meter_bar(smax, smax + 1, backcolor);
+		}
+		
+		if(pk >= sv)
+		{
+		    draw_meter_bar(pk, pk + 1, WHITE);
+		}
+		smax = pk;
+	}	
+}
+
+void draw_meter_scale(int meter_type)
+{
+	int y = 7 * FONTHEIGHT;
+	
+	//New scale starts with empty bar graph
+	draw_meter_bar(0, 120, backcolor);
+	sv_old = 0;
+	smax = 0;
+	
+	lcd_putstring_P(0, y, PSTR("               "), LIGHTYELLOW, backcolor, 1, 1);
+	if(!meter_type)
+    {
+        lcd_putstring2_P(0, y, PSTR("S13579"), LIGHTGREEN, backcolor, 3); //, 1, 1);
+        lcd_putstring2_P(65, y, PSTR("+10"), LIGHTYELLOW, backcolor, 0); //, 1, 1);
+        lcd_putstring2_P(89, y, PSTR("+20dB"), LIGHTRED, backcolor, 0); //, 1, 1);
+    }
+    else
+    {
+        lcd_putstring_P(0, y, PSTR("0 2  4  6  8 10W"), LIGHTYELLOW, backcolor, 1, 1);
+    }
+}
+
+////////////////////////////////////////////////////
+//               INTERRUPT HANDLERS
+////////////////////////////////////////////////////
+//Rotary encoder
+ISR(PCINT0_vect)
+{ 
+    int gray = (PINB & 0x03);           // Read PB0 and PB1
+	
+    int state = (gray >> 1) ^ gray;         // Convert from Gray code to binary
+
+    if (state != laststate)                //Compare states
+    {        
+        tuningknob += ((laststate - state) & 0x03) - 2; // Results in -1 or +1
+        laststate = state;
+        tuningcount++;
+    } 
+	PCIFR |=  (1 << PCIF0); // Clear pin change interrupt flag.
+}
+
+//Timer 0 1ms tick
+ISR(TIMER0_COMPA_vect)
+{
+	ms_ticks++;
+	key_scan();
+}
+
+//Timer 1 seconds counter
+ISR(TIMER1_COMPA_vect)
+{
+    runseconds10++; 
+    tuningcount = 0;
+    sleep_disable();
+}
+
+//Calculating tuningrate from rev/time unit
+int calc_tuningfactor(void)
+{
+	return (tuningcount * (tuningcount >> 1)); 
+}	
+
+//Milliseconds from timer 0, wraps after 65.5s
+unsigned int get_ms(void)
+{
+	unsigned int t;
+	uint8_t sreg = SREG;
+	
+	cli();
+	t = ms_ticks;
+	SREG = sreg;
+	
+	return t;
+}	
+
+//////////////////////
+//
+//   A   D   C   
+//
+/////////////////////
+//Start free running ADC sampler
+void adc_init(void)
+{
+	adc_slot = 0;
+	ADMUX = (1<<REFS0) + pgm_read_byte(&adc_schedule[0]);
+	ADCSRA = (1<<ADPS0) | (1<<ADPS1) | (1<<ADEN) | (1<<ADIE); //Prescaler 64, ADC on, IRQ on
+	ADCSRA |= (1<<ADSC);
+}
+
+//ADC conversion complete
+ISR(ADC_vect)
+{
+	int v = ADCL;
+	uint8_t ch = pgm_read_byte(&adc_schedule[adc_slot]);
+	unsigned int x;
+	
+	v += ADCH * 256;
+	adc_val[ch] = v;
+	
+	//PTT state machine
+	if(ch == 7)
+	{
+		if((!ptt_tx && v > PTT_ON) || (ptt_tx && v < PTT_OFF))
+		{
+			if(++ptt_cnt >= PTT_DEBOUNCE)
+			{
+				ptt_tx ^= 1;
+				ptt_event = 1;
+				ptt_cnt = 0;
+			}
+		}
+		else
+		{
+			ptt_cnt = 0;
+		}
+	}
+	
+	//S-Meter filter stage
+	if(ch == 1)
+	{
+		if(v > SMETER_OFFSET)
+		{
+			x = (v - SMETER_OFFSET) << 5;
+		}
+		else
+		{
+			x = 0;
+		}
+		
+		smeter_div++;
+		if(x > smeter_avg) //Attack
+		{
+			smeter_avg += (x - smeter_avg) >> SMETER_ATTACK;
+		}
+		else if(x < smeter_avg && !(smeter_div & 31)) //Decay, at least 1 so filter reaches x
+		{
+			smeter_avg -= ((smeter_avg - x) >> SMETER_DECAY) + 1;
+		}
+		
+		if(smeter_avg > smeter_peak) //Peak hold
+		{
+			smeter_peak = smeter_avg;
+			smeter_hold = SMETER_HOLD;
+		}
+		else if(!(smeter_div & 31))
+		{
+			if(smeter_hold)
+			{
+				smeter_hold--;
+			}
+			else
+			{
+				smeter_peak -= (smeter_peak - smeter_avg) >> 4;
+			}
+		}
+	}
+	
+	if(++adc_slot >= ADC_SLOTS)
+	{
+		adc_slot = 0;
+	}
+	
+	//Next channel, MUX may be changed as conversion has finished
+	ADMUX = (1<<REFS0) + pgm_read_byte(&adc_schedule[adc_slot]);
+	ADCSRA |= (1<<ADSC);
+}
+
+//Read latest ADC value of channel
+int get_adc(int adc_channel)
+{
+	int v;
+	uint8_t sreg = SREG;
+	
+	cli(); //16 bit value written by ISR
+	v = adc_val[adc_channel];
+	SREG = sreg;
+	
+	return v;
+}	
+
+//Convert S-Meter level (Q5) to dB over S0 thru smeter_db_tab
+int smeter_db(unsigned int q)
+{
+	unsigned int i = q >> 8; //Table step = 8 = 256 in Q5
+	int d0, d1;
+	
+	if(i >= 16)
+	{
+		return pgm_read_byte(&smeter_db_tab[16]);
+	}
+	
+	d0 = pgm_read_byte(&smeter_db_tab[i]);
+	d1 = pgm_read_byte(&smeter_db_tab[i + 1]);
+	
+	return d0 + (((d1 - d0) * (int) (q & 0xFF)) >> 8);
+}	
+
+//Smoothed S value in dB over S0 (S9 = 54)
+int get_s_value(void)
+{
+	unsigned int q;
+	uint8_t sreg = SREG;
+	
+	cli();
+	q = smeter_avg;
+	SREG = sreg;
+	
+	return smeter_db(q);
+}	
+
+//Peak hold S value in dB over S0
+int get_s_peak(void)
+{
+	unsigned int q;
+	uint8_t sreg = SREG;
+	
+	cli();
+	q = smeter_peak;
+	SREG = sreg;
+	
+	return smeter_db(q);
+}	
+
+//Clear filter after frequency change, so decay of old signal does not count
+void smeter_reset(void)
+{
+	uint8_t sreg = SREG;
+	
+	cli();
+	smeter_avg = 0;
+	SREG = sreg;
+}	
+
+//Track noise floor of current band with S value sampled while scanning
+void noise_update(int sval)
+{
+	int *nf = &noise_floor[cur_band];
+	
+	sval <<= 4;
+	if(*nf < 0)
+	{
+		*nf = sval;
+	}
+	else if(sval > *nf)
+	{
+		*nf += NF_UP;
+	}
+	else if(sval < *nf)
+	{
+		*nf -= NF_DOWN;
+		if(*nf < 0)
+		{
+			*nf = 0;
+		}
+	}
+}	
+
+//S value in dB that opens scan squelch: noise floor + margin thresh
+int squelch_level(void)
+{
+	if(noise_floor[cur_band] < 0)
+	{
+		return thresh;
+	}
+	return (noise_floor[cur_band] >> 4) + thresh;
+}	
+
+//S value in dB that starts fine search at a coarse step: SCAN_REFINE_DB
+//over noise floor, so noise alone does not trigger it, never over squelch
+int refine_level(void)
+{
+	int sq = squelch_level();
+	
+	if(noise_floor[cur_band] < 0 || (noise_floor[cur_band] >> 4) + SCAN_REFINE_DB > sq)
+	{
+		return sq;
+	}
+	return (noise_floor[cur_band] >> 4) + SCAN_REFINE_DB;
+}	
+
+//dB over S0 to bar graph position (S9 = 65, +10dB = 89)
+int smeter_db2px(int db)
+{
+	if(db <= 54)
+	{
+		return db * 65 / 54;
+	}
+	return 65 + (db - 54) * 24 / 10;
+}	
+
+//////////////////////
+//
+//   S E N S O R S
+//
+/////////////////////
+//Linear interpolation in 33 entry PROGMEM table for ADC = 0, 32, 64...1024
+int sensor_lookup(const int *tab, int adc)
+{
+	int i = adc >> 5;
+	int y0 = (int16_t) pgm_read_word(&tab[i]);
+	int y1 = (int16_t) pgm_read_word(&tab[i + 1]);
+	
+	return y0 + (int) (((long) (y1 - y0) * (adc & 31)) >> 5);
+}	
+
+//PA temperature in degrees C from ADC3
+int get_pa_temp(void)
+{
+	return sensor_lookup(pa_temp_tab, get_adc(3)) / 16;
+}	
+
+//Supply voltage in 0.1V from ADC6, 1:6 divider: ADC * 5 / 1024 * 6 * 10 = ADC * 75 / 256
+int get_voltage(void)
+{
+	return (int) (((long) get_adc(6) * 75) >> 8);
+}
+
+//TX power in 0.1W from ADC2
+int get_tx_power(void)
+{
+	return sensor_lookup(tx_pwr_tab, get_adc(2));
+}
+
+//TX power in 0.1W to bar graph position on "0 2  4  6  8 10W" scale
+int tx_power2px(int p)
+{
+	if(p < 20)
+	{
+		return p * 8 / 10;
+	}
+	return p * 12 / 10 - 8;
+}	
+
+//////////////////////////////
+//
+//    EEPROM-Functions
+//
+//////////////////////////////
+//Write one byte from queue, unchanged bytes are skipped
+ISR(EE_READY_vect)
+{
+	uint8_t t = ee_tail;
+	
+	if(t == ee_head) //Queue empty
+	{
+		EECR &= ~(1 << EERIE);
+		return;
+	}
+	
+	EEAR = ee_adr[t];
+	EECR |= (1 << EERE);
+	if(EEDR != ee_dat[t])
+	{
+		EEDR = ee_dat[t];
+		EECR |= (1 << EEMPE);
+		EECR |= (1 << EEPE);
+	}
+	ee_tail = (t + 1) & (EE_QUEUE - 1);
+}
+
+//Queue byte for EEPROM. Bytes are written in queue order, callers rely on it
+//(config CRC after its data), so only the newest entry is merged if it has
+//the same address, an older pending byte to that address is written again
+void ee_write_byte(int adr, uint8_t value)
+{
+	uint8_t t1, sreg;
+	
+	for(;;)
+	{
+		sreg = SREG;
+		cli();
+		t1 = (ee_head - 1) & (EE_QUEUE - 1);
+		if(ee_head != ee_tail && ee_adr[t1] == adr)
+		{
+			ee_dat[t1] = value;
+			SREG = sreg;
+			return;
+		}
+		
+		if(((ee_head + 1) & (EE_QUEUE - 1)) != ee_tail) //Space left
+		{
+			ee_adr[ee_head] = adr;
+			ee_dat[ee_head] = value;
+			ee_head = (ee_head + 1) & (EE_QUEUE - 1);
+			EECR |= (1 << EERIE);
+			SREG = sreg;
+			return;
+		}
+		SREG = sreg; //Queue full, wait for ISR
+	}
+}
+
+//Read byte, newest pending data from queue has priority
+uint8_t ee_read_byte(int adr)
+{
+	uint8_t t1, v, sreg;
+	int found;
+	
+	for(;;)
+	{
+		sreg = SREG;
+		cli();
+		found = 0;
+		for(t1 = ee_tail; t1 != ee_head; t1 = (t1 + 1) & (EE_QUEUE - 1))
+		{
+			if(ee_adr[t1] == adr)
+			{
+				v = ee_dat[t1];
+				found = 1;
+			}
+		}
+		if(found)
+		{
+			SREG = sreg;
+			return v;
+		}
+		
+		if(!(EECR & (1 << EEPE))) //No write in progress
+		{
+			EEAR = adr;
+			EECR |= (1 << EERE);
+			v = EEDR;
+			SREG = sreg;
+			return v;
+		}
+		SREG = sreg;
+	}
+}
+
+//Wait until all queued bytes are in EEPROM (before sleep or power down)
+void ee_flush(void)
+{
+	while(ee_head != ee_tail);
+	while(EECR & (1 << EEPE));
+}
+
+/*
+//Byte 64..67: VFOA on 80
+//Byte 68..71: VFOB on 80
+//Byte 72..75: VFOA on 40
+//Byte 76..79: VFOB on 40
+//Byte 80..83: VFOA on 20
+//Byte 84..87: VFOB on 20
+//Byte 88..91: VFOA on 15
+//Byte 92..95: VFOB on 15
+//Byte 96..99: VFOA on 10
+//Byte 100..103: VFOB on 10
+//VFO data offset = 32
+*/
+uint16_t config_crc(void)
+{
+	uint8_t *p = (uint8_t*) &cfg;
+	uint16_t crc = 0xFFFF;
+	int t1;
+	
+	for(t1 = 0; t1 < (int) sizeof(cfg) - 2; t1++)
+	{
+		crc = _crc16_update(crc, p[t1]);
+	}
+	return crc;
+}
+
+//Copy len bytes from src into config field dst, queue field and CRC for
+//copy A, then for copy B, so one complete copy survives a torn write
+void config_write(void *dst, const void *src, int len)
+{
+	int ofs = (uint8_t*) dst - (uint8_t*) &cfg;
+	
+	if(!memcmp(dst, src, len))
+	{
+		return;
+	}
+	
+	memcpy(dst, src, len);
+	cfg.crc = config_crc();
+	config_put(OFF_CONFIG, ofs, len);
+	config_put(OFF_CONFIG_B, ofs, len);
+}
+
+//Queue len bytes of cfg from ofs and the CRC for copy at adr,
+//bytes that are already in EEPROM are skipped by the write IRQ
+void config_put(int adr, int ofs, int len)
+{
+	uint8_t *p = (uint8_t*) &cfg;
+	int t1;
+	
+	for(t1 = ofs; t1 < ofs + len; t1++)
+	{
+		ee_write_byte(adr + t1, p[t1]);
+	}
+	ee_write_byte(adr + sizeof(cfg) - 2, cfg.crc & 0xFF);
+	ee_write_byte(adr + sizeof(cfg) - 1, cfg.crc >> 8);
+}
+
+//Read config block. Old layout is migrated only if there has never been
+//a config block (version). With a bad CRC copy B is used, defaults if
+//that is bad, too. Both copies are made equal afterwards.
+void config_load(void)
+{
+	int t1;
+	
+	eeprom_read_block(&cfg, (const void*) OFF_CONFIG, sizeof(cfg));
+	if(cfg.version != CONFIG_VERSION)
+	{
+		config_migrate();
+	}
+	else if(cfg.crc != config_crc())
+	{
+		eeprom_read_block(&cfg, (const void*) OFF_CONFIG_B, sizeof(cfg));
+		if(cfg.version != CONFIG_VERSION || cfg.crc != config_crc())
+		{
+			config_defaults();
+		}
+	}
+	config_put(OFF_CONFIG, 0, sizeof(cfg) - 2);
+	config_put(OFF_CONFIG_B, 0, sizeof(cfg) - 2);
+	
+	for(t1 = 0; t1 < MAXBANDS; t1++)
+	{
+		tx_preset[t1] = cfg.tx_preset[t1];
+	}
+	f_lo[0] = cfg.f_lo[0];
+	f_lo[1] = cfg.f_lo[1];
+	thresh = cfg.thresh;
+	rx_att = cfg.rx_att;
+	agc = cfg.agc;
+	cur_tone = cfg.tone;
+}
+
+//Config block with default settings
+void config_defaults(void)
+{
+	int band;
+	
+	cfg.version = CONFIG_VERSION;
+	for(band = 0; band < MAXBANDS; band++)
+	{
+		cfg.f[band][0] = f_vfo[band][0]; //Initial values
+		cfg.f[band][1] = f_vfo[band][1];
+		cfg.tx_preset[band] = 2048;
+	}
+	cfg.f_lo[0] = f_lo[0];
+	cfg.f_lo[1] = f_lo[1];
+	cfg.thresh = 5;
+	cfg.rx_att = 0;
+	cfg.agc = 0;
+	cfg.tone = 0;
+	cfg.crc = config_crc();
+}
+
+//Build config block from old EEPROM layout, defaults for invalid entries
+void config_migrate(void)
+{
+	int band, vfo, t1;
+	long f;
+	
+	config_defaults();
+	for(band = 0; band < MAXBANDS; band++)
+	{
+		for(vfo = 0; vfo < 2; vfo++)
+		{
+			f = 0;
+			for(t1 = 0; t1 < 4; t1++) //MSB first
+			{
+				f = (f << 8) + ee_read_byte(vfo * 4 + band * 8 + OFF_FREQ_DATA + t1);
+			}
+			if(is_band_freq(f, band))
+			{
+				cfg.f[band][vfo] = f;
+			}
+		}
+		cfg.tx_preset[band] = load_tx_preset(band);
+	}
+	
+	t1 = ee_read_byte(138);
+	if(t1 <= 12)
+	{
+		cfg.thresh = t1;
+	}
+	t1 = ee_read_byte(140);
+	if(t1 <= 1)
+	{
+		cfg.rx_att = t1;
+	}
+	t1 = ee_read_byte(142);
+	if(t1 <= 1)
+	{
+		cfg.tone = t1;
+	}
+	//AGC stays off, byte 142 was overwritten by AGC menu
+	cfg.crc = config_crc();
+}
+
+//Stored frequency based on VFO and band
+long load_frequency(int vfo, int band)
+{
+	return cfg.f[band][vfo];
+}
+
+void store_frequency(int vfo, int band, long f)
+{
+	CONFIG_SAVE(f[band][vfo], f);
+}
+
+int load_vfo(int xband)
+{
+	int start_adr = xband + OFF_VFO_DATA;
+	int r = ee_read_byte(start_adr);
+	
+	if((r == 0) || (r == 1))
+	{	
+		return(r);
+	}
+	return(-1);	
+}	
+
+
+
+int load_band(void)
+{
+	int start_adr = OFF_LAST_BAND_USED;
+	int r = ee_read_byte(start_adr);
+	
+	if((r >= 0) && (r <= 4))
+	{	
+		return(r);
+	}
+	return(-1);	
+}	
+
+//Checksum over header and the fields present in a record
+uint8_t log_chksum(uint8_t *rec)
+{
+	uint8_t t1, sum = rec[0];
+	
+	for(t1 = 1; t1 < LOG_REC - 1; t1++)
+	{
+		if(rec[0] & (1 << (t1 - 1)))
+		{
+			sum += rec[t1];
+		}
+	}
+	return sum ^ 0xA5;
+}	
+
+int log_valid(uint8_t *rec)
+{
+	if((rec[0] >> 4) >= LOG_SEQ || !(rec[0] & 0x0F) || rec[5] != log_chksum(rec))
+	{
+		return 0;
+	}
+	return !(rec[0] & 1) || (rec[1] & 7) < MAXBANDS;
+}	
+
+void log_read(int slot, uint8_t *rec)
+{
+	int t1;
+	
+	for(t1 = 0; t1 < LOG_REC; t1++)
+	{
+		rec[t1] = ee_read_byte(OFF_STATE_LOG + slot * LOG_REC + t1);
+	}
+}	
+
+//Save frequency, band, VFO and sideband as new record in state log,
+//only changed fields are written, nothing if state is unchanged
+void store_current_operation(int cband, int cvfo, int sband, long frequency)
+{
+	uint8_t rec[LOG_REC];
+	long offset = frequency - band_f0[cband];
+	uint8_t mask = 0;
+	int t1, adr;
+	
+	rec[1] = cband | (cvfo << 3) | (sband << 4);
+	rec[2] = offset >> 16;
+	rec[3] = offset >> 8;
+	rec[4] = offset;
+	
+	for(t1 = 1; t1 < LOG_REC - 1; t1++)
+	{
+		if(rec[t1] != log_rec[t1])
+		{
+			mask |= 1 << (t1 - 1);
+		}
+	}
+	
+	if(log_pos >= 0 && log_cnt < LOG_FULL && !mask)
+	{
+		return;
+	}
+	
+	if(log_pos >= 0)
+	{
+		rec[0] = (((log_rec[0] >> 4) + 1) % LOG_SEQ) << 4;
+	}
+	else
+	{
+		rec[0] = 0;
+	}
+	
+	//Full record, so state can be rebuilt from at most LOG_FULL records
+	if(log_pos < 0 || ++log_cnt >= LOG_FULL)
+	{
+		mask = 0x0F;
+		log_cnt = 0;
+	}
+	rec[0] |= mask;
+	rec[5] = log_chksum(rec);
+	
+	log_pos++;
+	if(log_pos >= LOG_SLOTS)
+	{
+		log_pos = 0;
+	}
+	
+	//Fields first, header and checksum last
+	adr = OFF_STATE_LOG + log_pos * LOG_REC;
+	for(t1 = 1; t1 < LOG_REC - 1; t1++)
+	{
+		if(mask & (1 << (t1 - 1)))
+		{
+			ee_write_byte(adr + t1, rec[t1]);
+		}
+	}
+	ee_write_byte(adr, rec[0]);
+	ee_write_byte(adr + LOG_REC - 1, rec[5]);
+	memcpy(log_rec, rec, LOG_REC);
 }	
 
-
-//Init LCD to vertical alignement and 16-bit color mode
-void lcd_init(void)
+//Find newest valid record in state log: the one whose successor
+//is empty, corrupted or has no consecutive sequence number, then
+//collect the fields from it and its predecessors back to a full record.
+//Returns 1 and sets cur_band, cur_vfo, sideband and frequency if found
+int load_current_operation(void)
 {
+	uint8_t rec[LOG_REC];
+	int t1, t2, slot, valid, valid0 = 0;
+	uint8_t seq, seq0 = 0, need = 0x0F;
+	long f;
+	
+	log_pos = -1;
+	log_cnt = LOG_FULL;
+	for(t1 = LOG_SLOTS - 1; t1 >= 0; t1--) //Backwards, so successor is known
+	{
+		log_read(t1, rec);
+		valid = log_valid(rec);
+		
+		if(valid && (t1 == LOG_SLOTS - 1 || !valid0 || seq0 != ((rec[0] >> 4) + 1) % LOG_SEQ))
+		{
+			log_pos = t1;
+			if(t1 < LOG_SLOTS - 1)
+			{
+				break;
+			}
+		}
+		valid0 = valid;
+		seq0 = rec[0] >> 4;
+	}
+	
+	if(log_pos < 0)
+	{
+		return 0;
+	}
+	
+	slot = log_pos;
+	log_read(slot, rec);
+	seq = rec[0] >> 4;
+	log_rec[0] = rec[0];
+	for(t1 = 0; ; t1++)
+	{
+		for(t2 = 1; t2 < LOG_REC - 1; t2++)
+		{
+			if(need & rec[0] & (1 << (t2 - 1)))
+			{
+				log_rec[t2] = rec[t2];
+			}
+		}
+		need &= ~rec[0];
+		
+		if((rec[0] & 0x0F) == 0x0F) //Full record
+		{
+			break;
+		}
+		
+		slot = (slot + LOG_SLOTS - 1) % LOG_SLOTS; //Predecessor
+		log_read(slot, rec);
+		if(t1 + 1 >= LOG_FULL || !log_valid(rec) || (rec[0] >> 4) != (seq + LOG_SEQ - (t1 + 1)) % LOG_SEQ)
+		{
+			return 0; //Chain broken, next record will be a full one
+		}
+	}
+	log_cnt = t1;
+	
+	cur_band = log_rec[1] & 7;
+	cur_vfo = (log_rec[1] >> 3) & 1;
+	sideband = (log_rec[1] >> 4) & 1;
+	f = band_f0[cur_band] + ((long) log_rec[2] << 16) + ((unsigned int) log_rec[3] << 8) + log_rec[4];
+	if(!is_band_freq(f, cur_band))
+	{
+		f = c_freq[cur_band];
+	}
+	f_vfo[cur_band][cur_vfo] = f;
+	
+	return 1;
+}	
 
-	lcd_write_command(ST7735_SWRESET); // software reset
-	_delay_ms(5);
-
-	lcd_write_command(ST7735_SLPOUT);  // out of sleep mode
-	_delay_ms(5);
-
-	lcd_write_command(ST7735_COLMOD);  // set color mode
-	lcd_write_data(0x05);              // 16-bit color
-	_delay_ms(10);
-
-	lcd_write_command(ST7735_FRMCTR1); // frame rate control
-	lcd_write_data(0x00);              // fastest refresh
-	lcd_write_data(0x06);              // 6 lines front porch
-	lcd_write_data(0x03);              // 3 lines backporch
-	_delay_ms(1);
-
-	lcd_write_command(ST7735_MADCTL);  // memory access control (directions)
-	lcd_write_data(0xC8);              // row address/col address, bottom to top refresh
-
-	lcd_write_command(ST7735_DISSET5); // display settings #5
-	lcd_write_data(0x15);              // 1 clock cycle nonoverlap, 2 cycle gate rise, 3 cycle oscil. equalize
-	lcd_write_data(0x02);              // fix on VTL
-
-	lcd_write_command(ST7735_INVCTR);  // display inversion control
-	lcd_write_data(0x0);               // line inversion
+//////////////////////////////
+//
+//    M   E   M   O   R   Y
+//
+//////////////////////////////
+unsigned long mem_get(int ch)
+{
+	unsigned long v = 0;
+	int t1;
+	
+	for(t1 = 0; t1 < 4; t1++)
+	{
+		v = (v << 8) + ee_read_byte(OFF_MEM + ch * 4 + t1);
+	}
+	return v;
+}
 
-	lcd_write_command(ST7735_GMCTRP1);
-	lcd_write_data(0x09);
-	lcd_write_data(0x16);
-	lcd_write_data(0x09);
-	lcd_write_data(0x20);
-	lcd_write_data(0x21);
-	lcd_write_data(0x1B);
-	lcd_write_data(0x13);
-	lcd_write_data(0x19);
-	lcd_write_data(0x17);
-	lcd_write_data(0x15);
-	lcd_write_data(0x1E);
-	lcd_write_data(0x2B);
-	lcd_write_data(0x04);
-	lcd_write_data(0x05);
-	lcd_write_data(0x02);
-	lcd_write_data(0x0E);
+void mem_put(int ch, unsigned long v)
+{
+	int t1;
+	
+	for(t1 = 0; t1 < 4; t1++)
+	{
+		ee_write_byte(OFF_MEM + ch * 4 + t1, v >> (24 - t1 * 8));
+	}
+}
 
-	lcd_write_command(ST7735_GMCTRN1);
-	lcd_write_data(0x0B);
-	lcd_write_data(0x14);
-	lcd_write_data(0x08);
-	lcd_write_data(0x1E);
-	lcd_write_data(0x22);
-	lcd_write_data(0x1D);
-	lcd_write_data(0x18);
-	lcd_write_data(0x1E);
-	lcd_write_data(0x1B);
-	lcd_write_data(0x1A);
-	lcd_write_data(0x24);
-	lcd_write_data(0x2B);
-	lcd_write_data(0x06);
-	lcd_write_data(0x06);
-	lcd_write_data(0x02);
-	lcd_write_data(0x0F);
-	_delay_ms(10);
+//Current radio state as memory channel
+unsigned long mem_encode(void)
+{
+	unsigned long offset = f_vfo[cur_band][cur_vfo] - band_f0[cur_band];
 	
-	lcd_write_command(ST7735_NORON);   // Normal display on
-	_delay_ms(10);
+	return ((unsigned long) cur_band << 29) | ((offset & 0xFFFFF) << 9) | (sideband << 3) | (rx_att << 2) | (agc << 1) | cur_tone;
+}
 
-	lcd_write_command(ST7735_DISPON);  //Display ON
-}	
+//Set band, frequency, sideband, ATT, AGC and TONE from memory channel in one go,
+//only changed Si5351 registers and relays are touched
+void mem_apply(unsigned long v)
+{
+	int band = v >> 29;
+	
+	if(band != cur_band)
+	{
+		cur_band = band;
+		set_band(cur_band);
+		mcp4725_set_value(tx_preset[cur_band]);
+	}
+	f_vfo[cur_band][cur_vfo] = mem_freq(v);
+	sideband = (v >> 3) & 1;
+	rx_att = (v >> 2) & 1;
+	agc = (v >> 1) & 1;
+	cur_tone = v & 1;
+	
+	set_att(rx_att);
+	set_agc(agc);
+	set_tone(cur_tone);
+	set_lo(sideband);
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+}
 
-//Define window area for next graphic operation
-void lcd_setwindow(int x0, int y0, int x1, int y1)
+long mem_freq(unsigned long v)
 {
-	lcd_write_command(ST7735_CASET);   //Coloumn address set
-	lcd_write_data(0x00);
-	lcd_write_data(x0);          
-	lcd_write_data(0x00);
-	lcd_write_data(x1);          
+	return band_f0[v >> 29] + ((v >> 9) & 0xFFFFF);
+}
 
-	lcd_write_command(ST7735_RASET);   //Row address set
-	lcd_write_data(0x00);
-	lcd_write_data(y0);        
-	lcd_write_data(0x00);
-	lcd_write_data(y1);        
+//Binary search in index: first position with channel >= v,
+//EEPROM is read only if RAM keys are equal
+int mem_search(unsigned long v)
+{
+	int lo = 0, hi = mem_cnt, mid;
+	uint16_t k = MEM_KEY(v);
+	
+	while(lo < hi)
+	{
+		mid = (lo + hi) >> 1;
+		if(mem_key[mid] < k || (mem_key[mid] == k && mem_get(mem_idx[mid]) < v))
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
 }
 
-//Set a pixel (Not used, just for academic purposes!)
-void lcd_setpixel(int x, int y, unsigned int color)
+void mem_index_add(int ch, unsigned long v)
 {
-	lcd_setwindow(x, y, x, y);
-	lcd_write_command(ST7735_RAMWR);		// RAM access set
-	lcd_write_data(color >> 8);
-	lcd_write_data(color);
+	int pos = mem_search(v);
+	
+	memmove(&mem_idx[pos + 1], &mem_idx[pos], mem_cnt - pos);
+	memmove(&mem_key[pos + 1], &mem_key[pos], (mem_cnt - pos) * sizeof(mem_key[0]));
+	mem_idx[pos] = ch;
+	mem_key[pos] = MEM_KEY(v);
+	mem_cnt++;
+	mem_used[ch >> 3] |= (1 << (ch & 7));
 }
 
-//Clear full LCD with background color
-void lcd_cls0(unsigned int bgcolor)
+void mem_index_remove(int ch)
 {
 	int t1;
-	lcd_setwindow(0, 0, 132, 132);
-	lcd_write_command(ST7735_RAMWR);		// RAM access set
-		
-    for(t1 = 0; t1 <= 17424; t1++)
-    {
-		lcd_write_data(bgcolor >> 8);
-	    lcd_write_data(bgcolor);
-	}    
-}	
+	
+	for(t1 = 0; t1 < mem_cnt; t1++)
+	{
+		if(mem_idx[t1] == ch)
+		{
+			mem_cnt--;
+			memmove(&mem_idx[t1], &mem_idx[t1 + 1], mem_cnt - t1);
+			memmove(&mem_key[t1], &mem_key[t1 + 1], (mem_cnt - t1) * sizeof(mem_key[0]));
+			mem_used[ch >> 3] &= ~(1 << (ch & 7));
+			return;
+		}
+	}
+}
 
-//Clear part of LCD with background color
-void lcd_cls1(int x0, int y0, int x1, int y1, unsigned int bgcolor)
+//Build RAM index of used channels at boot, each channel is read once
+void mem_index_build(void)
 {
-	int t1, sz = (x1 - x0) * (y1 - y0);
-	lcd_setwindow(x0, y0, x1, y1);
-	lcd_write_command(ST7735_RAMWR);		// RAM access set
-		
-    for(t1 = 0; t1 <= sz; t1++)
-    {
-		lcd_write_data(bgcolor >> 8);
-	    lcd_write_data(bgcolor);
-	}    
-}	
+	int t1;
+	unsigned long v;
+	
+	mem_cnt = 0;
+	memset(mem_used, 0, sizeof(mem_used));
+	for(t1 = 0; t1 < MEM_CHANNELS; t1++)
+	{
+		v = mem_get(t1);
+		if((v >> 29) < MAXBANDS)
+		{
+			mem_index_add(t1, v);
+		}
+	}
+}
 
-//Print one character to given coordinates to the screen
-//sx and sy define "stretch factor"
-void lcd_putchar(int x0, int y0, unsigned char ch0, unsigned int fcol, unsigned int bcol, int sx, int sy)
+//Store current state in channel with same band and frequency
+//or in first empty channel. Returns channel or -1 if bank is full
+int mem_store(void)
 {
-	int x, y, t1, t2;
-	unsigned char ch;
+	unsigned long v = mem_encode();
+	int pos = mem_search(v & ~0x1FFUL);
+	int ch;
 	
-    lcd_setwindow(x0 + 2, y0 + 2, x0 + FONTWIDTH * sx + 1, y0 + FONTHEIGHT * sy);
-	lcd_write_command(ST7735_RAMWR);
+	if(pos < mem_cnt && mem_key[pos] == MEM_KEY(v) && (mem_get(mem_idx[pos]) >> 9) == (v >> 9))
+	{
+		ch = mem_idx[pos];
+		mem_index_remove(ch);
+	}
+	else
+	{
+		for(ch = 0; ch < MEM_CHANNELS && (mem_used[ch >> 3] & (1 << (ch & 7))); ch++);
+		if(ch == MEM_CHANNELS)
+		{
+			return -1;
+		}
+	}
 	
-	for(y = 0; y < FONTHEIGHT - 1; y++)
+	mem_put(ch, v);
+	mem_index_add(ch, v);
+	
+	return ch;
+}
+
+//Channel number and data
+void mem_show(int ch)
+{
+	unsigned long v= mem_get(ch);
+	
+	lcd_putstring_P(0, 3 * FONTHEIGHT, PSTR("                "), WHITE, backcolor, 1, 1);
+	lcd_putstring_P(0, 4 * FONTHEIGHT, PSTR("                "), WHITE, backcolor, 1, 1);
+	lcd_putstring_P(0, 5 * FONTHEIGHT, PSTR("                "), WHITE, backcolor, 1, 1);
+	lcd_putstring_P(5 * FONTWIDTH, 3 * FONTHEIGHT, PSTR("CH"), YELLOW, backcolor, 1, 1);
+	lcd_putnumber(8 * FONTWIDTH, 3 * FONTHEIGHT, ch, -1, YELLOW, backcolor, 1, 1);
+	lcd_putnumber(4 * FONTWIDTH, 4 * FONTHEIGHT, mem_freq(v) / 100, 1, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(4 * FONTWIDTH, 5 * FONTHEIGHT, sb_str[(v >> 3) & 1], WHITE, backcolor, 1, 1);
+	if(v & 4)
 	{
-		ch = pgm_read_byte(&xchar[ch0 - CHAROFFSET][y]); 
-	    for(t1 = 0; t1 < sy; t1++)
-	    {
-	        for(x = 0; x < FONTWIDTH; x++)
-	        {
-		        if((1 << x) & ch)
-		        {
-					for(t2 = 0; t2 < sx; t2++)
-					{
-			            lcd_write_data(fcol >> 8);
-			            lcd_write_data(fcol);
-			        }    
-			    }
-	   	        else	
-		        {
-					for(t2 = 0; t2 < sx; t2++)
-					{
-			            lcd_write_data(bcol >> 8);
-			            lcd_write_data(bcol);
-			        }    
-			    }   
-		    }
-	    }	
+		lcd_putstring_P(8 * FONTWIDTH, 5 * FONTHEIGHT, PSTR("ATT"), LIGHTRED, backcolor, 1, 1);
 	}
-}	
+}
 
-//Print one \0 terminated string to given coordinates to the screen
-//xf and yf define "stretch factor"
-void lcd_putstring(int x0, int y0, char *s, unsigned int fcol, unsigned int bcol, int xf, int yf)
+//Step thru memory channels in order of frequency with rotary encoder,
+//starting at current frequency. Key 2 keeps channel, any other key restores old state.
+//ui_pos = index position, ui_old = encoded state before
+void mem_recall_open(void)
 {
-	int x = 0;
+	if(!mem_cnt)
+	{
+		show_msg_P(PSTR("No memories."));
+		return;
+	}
 	
-	while(*s)
+	store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]); //Leaving band
+	ui_old = mem_encode();
+	ui_pos = mem_search(ui_old);
+	if(ui_pos >= mem_cnt)
 	{
-		lcd_putchar(x + x0, y0, *(s++), fcol, bcol, xf, yf);
-		x += (FONTWIDTH * xf);
-	}	
+		ui_pos = 0;
+	}
+	
+	ui_screen = UI_RECALL;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(FONTWIDTH, FONTHEIGHT, PSTR("MEMORY RECALL"), WHITE, LIGHTBLUE, 1, 1);	
+	mem_apply(mem_get(mem_idx[ui_pos]));
+	mem_show(mem_idx[ui_pos]);
 }
 
-void lcd_putstring2(int x0, int y0, char *s, unsigned int fcol, unsigned int bcol, int xf)
+//Turn CW: next channel up in frequency
+void mem_recall_event(int key, int dir)
 {
-	int x = 0;
+	if(dir)
+	{
+		ui_pos += dir;
+		if(ui_pos >= mem_cnt)
+		{
+			ui_pos = 0;
+		}
+		if(ui_pos < 0)
+		{
+			ui_pos = mem_cnt - 1;
+		}
+		mem_apply(mem_get(mem_idx[ui_pos]));
+		mem_show(mem_idx[ui_pos]);
+	}
 	
-	while(*s)
+	if(!key)
 	{
-		lcd_putchar(x + x0, y0, *(s++), fcol, bcol, 1, 1);
-		x += (FONTWIDTH + xf);
-	}	
+		return;
+	}
+	if(key == 2)
+	{
+		mem_commit();
+	}
+	else
+	{
+		mem_apply(ui_old);
+	}
+	ui_close();
 }
 
-//Print a number
-//xf and yf define "stretch factor"
-int lcd_putnumber(int col, int row, long num, int dec, int fcolor, int bcolor, int xf, int yf)
+//Keep state of recalled channel
+void mem_commit(void)
 {
-    char *s = malloc(16);
-    int slen = 0;
-	if(s != NULL)
-	{
-	    int2asc(num, dec, s, 16);
-	    lcd_putstring(col, row, s, fcolor, bcolor, xf, yf);
-	    slen = strlen(s);
-	    free(s);
-	}	
-	return slen;
+	CONFIG_SAVE(rx_att, rx_att);
+	CONFIG_SAVE(agc, agc);
+	CONFIG_SAVE(tone, cur_tone);
+	store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
 }
 
-/////////////////////////////////
+
+//////////////////////////////
 //
-// STRING FUNCTIONS
+//    M   E   N   U
 //
-////////////////////////////////
-//INT 2 ASC
-int int2asc(long num, int dec, char *buf, int buflen)
+//////////////////////////////
+//Key state machine, called every ms from timer 0 IRQ
+void key_scan(void)
 {
-    int i, c, xp = 0, neg = 0;
-    long n, dd = 1E09;
-
-    if(!num)
+	uint8_t k = pgm_read_byte(&key_lut[adc_val[0] >> 2]);
+	
+	//Debounce
+	if(k != key_raw)
 	{
-	    *buf++ = '0';
-		*buf = 0;
-		return 1;
-	}	
-		
-    if(num < 0)
-    {
-     	neg = 1;
-	    n = num * -1;
-    }
-    else
-    {
-	    n = num;
-    }
-
-    //Fill buffer with \0
-    for(i = 0; i < 12; i++)
-    {
-	    *(buf + i) = 0;
-    }
-
-    c = 9; //Max. number of displayable digits
-    while(dd)
-    {
-	    i = n / dd;
-	    n = n - i * dd;
+		key_raw = k;
+		key_cnt = 0;
+	}
+	else if(key_cnt < KEY_T_DEBOUNCE)
+	{
+		key_cnt++;
+	}
 	
-	    *(buf + 9 - c + xp) = i + 48;
-	    dd /= 10;
-	    if(c == dec && dec)
-	    {
-	        *(buf + 9 - c + ++xp) = '.';
-	    }
-	    c--;
-    }
-
-    //Search for 1st char different from '0'
-    i = 0;
-    while(*(buf + i) == 48)
-    {
-	    *(buf + i++) = 32;
-    }
-
-    //Add minus-sign if neccessary
-    if(neg)
-    {
-	    *(buf + --i) = '-';
-    }
-
-    //Eleminate leading spaces
-    c = 0;
-    while(*(buf + i))
-    {
-	    *(buf + c++) = *(buf + i++);
-    }
-    *(buf + c) = 0;
+	//Stable change of key state
+	if(key_cnt == KEY_T_DEBOUNCE && k != key_stable)
+	{
+		if(key_stable && key_held < KEY_T_LONG) //Released before long press
+		{
+			key_put(key_stable | KEY_EV_SHORT);
+		}
+		key_stable = k;
+		key_held = 0;
+		key_rep = 0;
+	}
 	
-	return c;
+	//Key held
+	if(key_stable)
+	{
+		if(key_held < KEY_T_LONG)
+		{
+			if(++key_held == KEY_T_LONG)
+			{
+				key_put(key_stable | KEY_EV_LONG);
+			}
+		}
+		else if(++key_rep == KEY_T_REPEAT)
+		{
+			key_put(key_stable | KEY_EV_REPEAT);
+			key_rep = 0;
+		}
+	}
 }
 
-//////////////////////////////////
-//
-//  DATA DISPLAY FUNCTIONS
-//
-//////////////////////////////////
+//Put event into queue, dropped if full
+void key_put(uint8_t ev)
+{
+	uint8_t next = (key_q_in + 1) & (KEY_QUEUE - 1);
+	
+	if(next != key_q_out)
+	{
+		key_queue[key_q_in] = ev;
+		key_q_in = next;
+	}
+}
 
-void show_all_data(long f, int cband, int s, int vfo, int volts, int mtr_scale, int split_state)
+//Next key event from queue, 0 if none
+int get_key_event(void)
 {
-	int t1;
-	int y0 = 36;
-	int y1 = y0 + 10 + 2 * FONTHEIGHT;
+	int ev;
 	
-	lcd_cls0(backcolor);	
+	if(key_q_out == key_q_in)
+	{
+		return 0;
+	}
 	
-	for(t1 = 0; t1 < 16; t1++)
+	ev = key_queue[key_q_out];
+	key_q_out = (key_q_out + 1) & (KEY_QUEUE - 1);
+	
+	return ev;
+}
+
+//Next short key press (1..4), 0 if none. Other events are dropped.
+int get_keys(void)
+{
+	int ev = get_key_event();
+	
+	if(ev & 0xF0)
 	{
-		lcd_putchar(t1 * FONTWIDTH, y0, 0x83, YELLOW, backcolor, 1, 1);
-		lcd_putchar(t1 * FONTWIDTH, y1, 0x83, YELLOW, backcolor, 1, 1);
-	}	
-	show_frequency1(f, 2); 
-	show_band(cband, 0);
-	show_sideband(s, 0);
-	show_vfo(vfo, 0);
-	show_voltage(volts);
-	show_tone(cur_tone);
-	draw_meter_scale(mtr_scale);
-	show_split(split_state, backcolor);
-	show_att(rx_att);
-	show_agc(agc);
-}   
+		return 0;
+	}
+	return ev;
+}
 
-void show_frequency1(long f, int csize)
+//Draw frame
+void lcd_drawbox(int x0, int y0, int x1, int y1)
 {
-	int x;
-	int y = 50;
-	int fcolor;
+	int t1;
 	
-	if(is_band_freq(f, cur_band))
+	for(t1 = y0; t1 < y1 + 1; t1++)
 	{
-		fcolor = WHITE;
+		lcd_putchar(x0 * FONTWIDTH, t1 * FONTHEIGHT, 0x82, WHITE, backcolor, 1, 1);
+		lcd_putchar(x1 * FONTWIDTH, t1 * FONTHEIGHT, 0x82, WHITE, backcolor, 1, 1);
 	}
-	else	
+	
+	for(t1 = x0 + 1; t1 < x1; t1++)
 	{
-		fcolor = LIGHTRED;
+		lcd_putchar(t1 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x83, WHITE, backcolor, 1, 1);
+		lcd_putchar(t1 * FONTWIDTH, (y1 + 1)  * FONTHEIGHT, 0x83, WHITE, backcolor, 1, 1);
 	}
 	
-	if(f < 10000000)
+	//The "Cornerstones"
+	lcd_putchar(x0 * FONTWIDTH, (y1 + 1) * FONTHEIGHT, 0x84, WHITE, backcolor, 1, 1);
+	lcd_putchar(x1 * FONTWIDTH, (y1 + 1) * FONTHEIGHT, 0x85, WHITE, backcolor, 1, 1);
+	lcd_putchar(x0 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x86, WHITE, backcolor, 1, 1);
+	lcd_putchar(x1 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x87, WHITE, backcolor, 1, 1);
+}
+		
+//Head string in flash
+void print_menu_head(const char *head_str0, int m_items)
+{	
+    int xpos0 = (16 - strlen_P(head_str0)) / 2;
+	int ypos0 = 1;
+			
+	//lcd_cls0(backcolor);	
+	lcd_drawbox(4, 3, 13, 3 + m_items);
+	lcd_putstring_P(0, ypos0 * FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, head_str0, WHITE, LIGHTBLUE, 1, 1);	
+}
+
+void print_menu_item(int m, int i, int invert)
+{    
+	int xpos1 = 40;
+	
+	if(invert)
 	{
-		x = 128 - FONTWIDTH * 12 - 5;
+		lcd_putstring_P(xpos1, (i + 3) * FONTHEIGHT, menus[m].item[i], BLACK, WHITE, 1, 1);
 	}
 	else
 	{
-		x = 128 - FONTWIDTH * 14 - 5;
+		lcd_putstring_P(xpos1, (i + 3) * FONTHEIGHT, menus[m].item[i], WHITE, backcolor, 1, 1);
 	}	
+}
 	
-	if(f == 0)
+//Print the itemlist and higlight certain item (-1 = NO highlight)
+void print_menu_item_list(int menu, int item)
+{
+	int t1;
+    
+    for(t1 = 0; t1 < pgm_read_byte(&menus[menu].items) + 1; t1++)
 	{
-	    lcd_putstring(0, y, "       ", backcolor, backcolor, csize, csize);
+	    if(t1 == item)
+		{
+		    print_menu_item(menu, t1, 1);   
+		}
+		else
+		{
+		    print_menu_item(menu, t1, 0);   
+		}   
 	}
-	else
+}
+
+//Move cursor thru item list, preview only when cursor has moved.
+//Key 2 executes item, keys 1 and 3 quit. Preview is undone with the setting
+void menu1_event(int key, int dir)
+{
+	int items = pgm_read_byte(&menus[ui_menu].items);
+	int *setting = (int*) pgm_read_ptr(&menus[ui_menu].setting);
+	void (*preview)(int) = (void (*)(int)) pgm_read_ptr(&menus[ui_menu].preview);
+	void (*action)(int);
+	
+	if(dir)
 	{
-		if(csize == 1)
+		print_menu_item(ui_menu, ui_pos, 0); //Write old entry in normal color
+		ui_pos += dir;
+		if(ui_pos > items)
 		{
-		    lcd_putnumber(x, y, f, 3, fcolor, backcolor, csize, csize);
-		}    
-		else
+			ui_pos = 0;
+		}
+		if(ui_pos < 0)
 		{
-		    lcd_putnumber(x, y, f / 100, 1, fcolor, backcolor, csize, csize);
+			ui_pos = items;
 		}
-	}	    
+		print_menu_item(ui_menu, ui_pos, 1); //Write new entry in reverse color
+		if(preview)
+		{
+			preview(ui_pos);
+		}
+	}
+	
+	if(!key)
+	{
+		return;
+	}
+	if(preview && setting)
+	{
+		preview(*setting);
+	}
+	
+	if(key == 2)
+	{
+		ui_screen = UI_MAIN;
+		action = (void (*)(int)) pgm_read_ptr(&menus[ui_menu].action[ui_pos]);
+		action(ui_pos);
+		if(ui_screen == UI_MAIN) //Item has not opened another screen
+		{
+		    ui_close();
+		}
+	}
+	else
+	{
+		ui_close();
+	}
+}	
 
-}
+//VFO A or B on air, frequency shown in item list
+void preview_vfo(int vfo)
+{
+	if(vfo < 2)
+	{
+	    set_vfo(f_vfo[cur_band][vfo] + f_lo[sideband]);
+	    lcd_putnumber(FONTWIDTH * 4, FONTHEIGHT * 6, f_vfo[cur_band][vfo] / 100, 1, WHITE, backcolor, 1, 1);
+	}
+}	
 
-void show_frequency2(long f)
+//LO of LSB or USB, other items keep current one
+void preview_lo(int sb)
 {
-	int xpos, ypos = 2 * FONTHEIGHT;
-	
-	if(f < 10000000)
+	if(sb < 2)
 	{
-		xpos = 10 * FONTWIDTH;
+		set_lo(sb);
 	}
 	else
 	{
-		xpos = 9 * FONTWIDTH;
-	}	
-	
-	lcd_putstring(9 * FONTWIDTH, ypos, "       ", WHITE, backcolor, 1, 1);
-	lcd_putnumber(xpos, ypos, f / 100, 1, WHITE, backcolor, 1, 1);
+		set_lo(sideband);
+	}
 }
 
-void show_band(int band, int invert)
+//Calculate coordinates
+int menu0_get_xp(int x)
 {
-	char *band_str[MAXBANDS] = {"80m", "40m", "20m", "17m", "15m"};
-	int xpos = 0, ypos = 0;	 
-	int forecolor = WHITE;
-	
-	switch(band)
-	{
-		case 0: forecolor = LIGHTBLUE;
-		        break;
-		case 1: forecolor = LIGHTBROWN;
-		        break;
-		case 2: forecolor = LIGHTGREEN;
-		        break;
-		case 3: forecolor = LIGHTGRAY;
-		        break;
-		case 4: forecolor = LIGHTVIOLET2;
-		        break;
-	}	        
+	return x * FONTWIDTH * 8 + 2 * FONTWIDTH;
+}	
+
+int menu0_get_yp(int y)
+{
+	return (y + 2) * FONTHEIGHT;
+}	
+
+//Menu name c in 2 x 6 grid, normal or reverse
+void menu0_show_item(int c, int invert)
+{
+	int y = c / 2;
+	int x = c - (y * 2);
 	
 	if(invert)
-	{	
-	     lcd_putstring(xpos, ypos, band_str[band], backcolor, forecolor, 1, 1);
+	{
+	    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menus[c].name, DARKBLUE, WHITE, 1, 1);
 	}
-	else     
-	{	
-	     lcd_putstring(xpos, ypos, band_str[band], forecolor, backcolor, 1, 1);
+	else
+	{
+	    lcd_putstring_P(menu0_get_xp(x), menu0_get_yp(y), menus[c].name, WHITE, backcolor, 1, 1);
 	}
-}
+}	
+
+//Preselection menu
+void menu0_open(void)
+{
+	int c;
+	
+	ui_screen = UI_MENU0;
+	ui_pos = 0;
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, 1, PSTR("   MENU SELECT   "), YELLOW, LIGHTGRAY, 1, 1);
+	
+	for(c = 0; c < MENUSTRINGS; c++)
+	{
+		menu0_show_item(c, 0);
+	}
+	lcd_drawbox(1, 2, 14, 7);
+	menu0_show_item(ui_pos, 1);
+}	
 
-void show_sideband(int sb, int invert)
+//Select menu with encoder, key 2 opens it, other keys quit
+void menu0_event(int key, int dir)
 {
-	int xpos = 4 * FONTWIDTH, ypos = 0;
-	char *sidebandstr[MAXMODES + 1] = {"LSB", "USB"};
+	if(dir && ui_pos + dir >= 0 && ui_pos + dir < MENUSTRINGS)
+	{
+		menu0_show_item(ui_pos, 0);
+		ui_pos += dir;
+		menu0_show_item(ui_pos, 1);
+	}
 	
-	if(invert)
+	if(key == 2)
 	{
-		//Write string to position
-	    lcd_putstring(xpos * 6, ypos, sidebandstr[sb], backcolor, LIGHTBLUE, 1, 1);
+		menu1_open(ui_pos);
 	}
-	else
+	else if(key)
 	{
-		//Write string to position
-	    lcd_putstring(xpos, ypos, sidebandstr[sb], LIGHTBLUE, backcolor, 1, 1);
+		ui_close();
 	}
-	   
-}
+}	
 
-void show_split(int splt, int invert)
+//Item list of menu, cursor on current setting
+void menu1_open(int menu)
 {
-	int xpos = 0 * FONTWIDTH, ypos = 2 * FONTHEIGHT;
-	char *spltstr = "SPLT";
-	int splitcolor[] = {LIGHTGRAY, LIGHTRED};
-	//Write string to position
-	lcd_putstring(xpos, ypos, spltstr, splitcolor[splt], backcolor, 1, 1);
-	   
+	int *setting = (int*) pgm_read_ptr(&menus[menu].setting);
+	
+	ui_screen = UI_MENU1;
+	ui_menu = menu;
+	ui_pos = (setting) ? *setting : 0;
+	
+	lcd_cls0(backcolor);	
+	print_menu_head(menus[menu].title, pgm_read_byte(&menus[menu].items));	//Head outline of menu
+	print_menu_item_list(menu, ui_pos);
 }
 
-void show_vfo(int vfo, int invert)
+//Frequency of LO sb in 10Hz steps by ear
+void lo_set_open(int sb)
 {
-	int xpos = 8 * FONTWIDTH, ypos = 0;
-	char *vfostr[] = {"VFOA", "VFOB"};
+	int t1;
+		
+	ui_screen = UI_LO_SET;
+	ui_val = sb;
+	lcd_cls0(backcolor);	
+		
+	for(t1 = 0; t1 < 16; t1++)
+	{
+	   lcd_putchar(t1 * FONTWIDTH, 1 * FONTHEIGHT, 32, WHITE, LIGHTBLUE, 1, 1);	
+	}   
+	lcd_putstring_P(2 * FONTWIDTH, 1 * FONTHEIGHT, PSTR("LO SET MODE"), WHITE, LIGHTBLUE, 1, 1);	
 	
-	//Show frequency of other VFO in d
-	if(!vfo)	
+	if(!sb)
 	{
-		show_frequency2(f_vfo[cur_band][1]);
+	    lcd_putstring_P(3 * FONTWIDTH, 2 * FONTHEIGHT, PSTR(" fLO LSB "), WHITE, BLUE, 1, 1);
 	}
-	else	
+	else    
 	{
-		show_frequency2(f_vfo[cur_band][0]);
+	    lcd_putstring_P(3 * FONTWIDTH, 2 * FONTHEIGHT, PSTR(" fLO USB "), WHITE, BLUE, 1, 1);
 	}
 	
-	//Write string to position
-	lcd_putstring(xpos, ypos, vfostr[vfo], YELLOW, backcolor, 1, 1);
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sb]);   
+	si5351_set_freq(SYNTH_MS_0, f_lo[sb]);
+	show_frequency1(f_lo[sb], 1);
 }
 
-
-void show_pa_temp(void)
+//Key 2 stores LO frequency, other keys restore stored one
+void lo_set_event(int key, int dir)
 {
-	int xpos = 12 * FONTWIDTH, ypos = FONTHEIGHT;
-	int tmp = get_pa_temp();
-	int fcolor = LIGHTGREEN;
+	int sb = ui_val;
 	
-	if(tmp > 40)
-	{
-		fcolor = LIGHTYELLOW;
+	if(dir)
+	{    
+	    f_lo[sb] += dir * 10;
+	    si5351_set_freq(SYNTH_MS_0, f_lo[sb]);
+		show_frequency1(f_lo[sb], 1);
 	}	
 	
-	if(tmp > 60)
+	if(!key)
 	{
-		fcolor = LIGHTRED;
-	}	
+		return;
+	}
 	
-	xpos = (12 + lcd_putnumber(xpos, ypos, tmp, -1, fcolor, backcolor, 1, 1)) * FONTWIDTH;
-	lcd_putchar(xpos, ypos, 0x88, fcolor, backcolor, 1, 1); //-sign
-	xpos += FONTWIDTH;
-	lcd_putchar(xpos, ypos, 'C', fcolor, backcolor, 1, 1); //C
-}
-
-void show_att(int status)
-{
-	int xpos = 5 * FONTWIDTH, ypos = 2 * FONTHEIGHT;
-
-
-    int fcolor;
-    	
-	if(!status)
+	if(key == 2)
 	{
-		fcolor = LIGHTGRAY;
+		CONFIG_SAVE(f_lo[sb], f_lo[sb]);
 	}
 	else
 	{
-		fcolor = LIGHTYELLOW;
-	}	
-
-	lcd_putstring(xpos, ypos, "ATT", fcolor, backcolor, 1, 1);
+		f_lo[sb] = cfg.f_lo[sb];
+	}
+	set_lo(sideband);
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
+	ui_close();
 }
 
-void show_agc(int status)
+//Pass key or encoder event to open screen
+void ui_event(int key, int dir)
 {
-	int xpos = 6 * FONTWIDTH, ypos = FONTHEIGHT;
-	
-    int fcolor;
-    	
-	if(status)
+	switch(ui_screen)
 	{
-		fcolor = LIGHTYELLOW;
-		lcd_putstring(xpos, ypos, "SLOW", fcolor, backcolor, 1, 1);
+		case UI_MENU0:     menu0_event(key, dir);
+		                   break;
+		case UI_MENU1:     menu1_event(key, dir);
+		                   break;
+		case UI_LO_SET:    lo_set_event(key, dir);
+		                   break;
+		case UI_TX_PRESET: tx_preset_event(key, dir);
+		                   break;
+		case UI_THRESH:    thresh_event(key, dir);
+		                   break;
+		case UI_RITXIT:    ritxit_event(key, dir);
+		                   break;
+		case UI_TUNE:      tune_event(key, dir);
+		                   break;
+		case UI_TASKS:     task_show_event(key, dir);
+		                   break;
+		case UI_RECALL:    mem_recall_event(key, dir);
+		                   break;
+		case UI_HITS:      hits_event(key, dir);
+		                   break;
+		case UI_XBAND:     xband_event(key, dir);
+		                   break;
+		case UI_VIEW:      view_event(key, dir);
+		                   break;
 	}
-	else
-	{
-	    fcolor = YELLOW;	
-		lcd_putstring(xpos, ypos, "FAST", fcolor, backcolor, 1, 1);
-	}	
-}
-	
-void show_voltage(int v1)
+}	
+
+//Back to main screen
+void ui_close(void)
 {
-    char *buffer;
-	int t1, p;
-	int xpos = 0, ypos = FONTHEIGHT;
-	int fcolor;
-		
-	buffer= malloc(0x10);
-	//Init buffer string
-	for(t1 = 0; t1 < 0x10; t1++)
+	if(ptt_event) //PTT during screen or menu action, RF goes before the redraw
 	{
-	    *(buffer + t1) = 0;
+		ptt_changeover();
 	}
-    
-    p = int2asc(v1, 1, buffer, 6) * FONTWIDTH + xpos;
-    
-    if(v1 < 10)
-    {
-		fcolor = RED;
-	}
-	
-	if(v1 >= 10 && v1 < 11)
-    {
-		fcolor = LIGHTRED;
-	}	
+	ui_screen = UI_MAIN;
+	sv_old = 0;
+	smax = 0;
+	show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, txrx, split);     
+}	
+
+//Noise level at LO frequency flo with VFO tracking the same RF f,
+//returns mean of IF_AVG samples in dB/2 units (fixed point, 1 LSB = 0.5dB)
+int if_level(long f, long flo)
+{
+	int t1, sum = 0;
+	unsigned int t0;
 	
-	if(v1 >= 11 && v1 < 13)
-    {
-		fcolor = GREEN;
-	}	
+	si5351_set_freq(SYNTH_MS_0, flo);
+	set_vfo(f + flo);
+	smeter_reset();
+	t0 = get_ms();
+	while(get_ms() - t0 < SCAN_SETTLE + 1);
 	
-	if(v1 >= 13)
-    {
-		fcolor = LIGHTGREEN;
-	}	
+	for(t1 = 0; t1 < IF_AVG; t1++)
+	{
+		t0 = get_ms();
+		while(get_ms() - t0 < 1);
+		sum += get_s_value();
+	}
 	
-    lcd_putstring(xpos, ypos, buffer, fcolor, backcolor, 1, 1);
-	lcd_putstring(p, ypos, "V ", fcolor, backcolor, 1, 1);
-	free(buffer);
-}
+	return (sum * 2) / IF_AVG;
+}	
 
-void show_tone(int status)
+//Sweep LO across the IF filter, VFO tracks so RF stays on dial frequency.
+//Noise level per point is averaged over sweeps (new = old + (sample - old) / 2)
+//and drawn normalized to min..max, LSB and USB carrier points are marked.
+//Repeats until a key is pressed or PTT, LO and VFO are restored before changeover
+void if_sweep(void)
 {
-	int xpos = 14 * FONTWIDTH, ypos = 0;
-		
-	//Write string to position
-	if(!status)
-	{
-	    lcd_putstring(xpos, ypos, "LO", YELLOW, backcolor, 1, 1);;
-	}
-	else    
+	int t1, t2, h, pmin, pmax;
+	int key = 0, pass = 0;
+	uint8_t pb[IF_POINTS];
+	long f = f_vfo[cur_band][cur_vfo];
+	long flo;
+	unsigned int color;
+	
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(2 * FONTWIDTH, FONTHEIGHT, PSTR("IF PASSBAND"), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(0, 8 * FONTHEIGHT, PSTR("-3k"), WHITE, backcolor, 1, 1);
+	lcd_putchar(7 * FONTWIDTH, 8 * FONTHEIGHT, '0', WHITE, backcolor, 1, 1);
+	lcd_putstring_P(12 * FONTWIDTH, 8 * FONTHEIGHT, PSTR("+3k"), WHITE, backcolor, 1, 1);
+	
+	while(!key)
 	{
-	    lcd_putstring(xpos, ypos, "HI", YELLOW2, backcolor, 1, 1);
+		pmin = 255;
+		pmax = 0;
+		for(t1 = 0; t1 < IF_POINTS && !key; t1++)
+		{
+			h = if_level(f, IF_CENTER - IF_SPAN / 2 + (long) t1 * IF_SPAN / IF_POINTS);
+			if(h > 255)
+			{
+				h = 255;
+			}
+			if(h < 0)
+			{
+				h = 0;
+			}
+			if(pass)
+			{
+				h = pb[t1] + (h - pb[t1]) / 2;
+			}
+			pb[t1] = h;
+			if(h < pmin)
+			{
+				pmin = h;
+			}
+			if(h > pmax)
+			{
+				pmax = h;
+			}
+			key = get_keys();
+			if(ptt_tx)
+			{
+				key = 3;
+			}
+		}
+		if(key)
+		{
+			break;
+		}
+		pass = 1;
+		
+		//Range in dB
+		lcd_putstring_P(0, 2 * FONTHEIGHT, PSTR("    "), WHITE, backcolor, 1, 1);	
+		t1 = lcd_putnumber(0, 2 * FONTHEIGHT, (pmax - pmin) / 2, -1, WHITE, backcolor, 1, 1);
+		lcd_putstring_P(t1 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("dB"), WHITE, backcolor, 1, 1);	
+		
+		for(t1 = 0; t1 < IF_POINTS; t1++)
+		{
+			h = (pmax > pmin) ? (pb[t1] - pmin) * HIST_HEIGHT / (pmax - pmin) : 0;
+			flo = IF_CENTER - IF_SPAN / 2 + (long) t1 * IF_SPAN / IF_POINTS;
+			color = GREEN;
+			if((f_lo[0] >= flo && f_lo[0] < flo + IF_SPAN / IF_POINTS) || (f_lo[1] >= flo && f_lo[1] < flo + IF_SPAN / IF_POINTS))
+			{
+				color = YELLOW;
+			}
+			
+			lcd_setwindow(t1 * 2 + 4, HIST_BOTTOM - HIST_HEIGHT + 1, t1 * 2 + 5, HIST_BOTTOM);
+			lcd_write_command(ST7735_RAMWR);
+			for(t2 = HIST_HEIGHT * 2 - 1; t2 >= 0; t2--)
+			{
+				if((t2 >> 1) < h)
+				{
+					lcd_write_data(color >> 8);
+					lcd_write_data(color & 0xFF);
+				}
+				else
+				{
+					lcd_write_data(backcolor >> 8);
+					lcd_write_data(backcolor & 0xFF);
+				}
+			}
+		}
 	}
+	
+	set_lo(sideband);
+	set_vfo(f + f_lo[sideband]);
 }	
 
-void show_msg(char *msg)
-{	
-	int xpos = 0, ypos = 8 * FONTHEIGHT;
-	lcd_putstring(xpos, ypos, "                ", WHITE, backcolor, 1, 1);
-	lcd_putstring(xpos, ypos, msg, WHITE, backcolor, 1, 1);
-	runseconds10msg = runseconds10;
-	msgstatus = 1;
-}	
-
-//S-Meter bargraph 
-void draw_meter_bar(int x0, int x1, int fcol)
+//Bisection for LO frequency where noise level crosses lvl (dB/2 units),
+//fin is inside passband (above lvl), fout outside. Stops early on PTT
+long if_edge(long f, long fin, long fout, int lvl)
 {
-	int t1;
+	long fm;
 	
-	lcd_setwindow(x0 + 2, 90, x1 + 2, 94);
-	lcd_write_command(ST7735_RAMWR);
-	for(t1 = 0; t1 < ((x1 - x0) << 2) + 4; t1++)
+	while(labs(fout - fin) > IF_RES && !ptt_tx)
 	{
-		lcd_write_data(fcol >> 8);
-	    lcd_write_data(fcol);
+		fm = (fin + fout) / 2;
+		if(if_level(f, fm) >= lvl)
+		{
+			fin = fm;
+		}
+		else
+		{
+			fout = fm;
+		}
 	}
+	
+	return (fin + fout) / 2;
 }	
 
-void show_meter(int sv0)
+//Find -6dB and -20dB edges of IF filter by bisection and put LSB carrier
+//on lower, USB carrier on upper -20dB point. Key 2 stores both, key 3 discards.
+//PTT discards at any point, LO and VFO are restored before changeover
+void if_autolo(void)
 {
-    int sv = sv0;
-    
-    if(sv > 120)
-    {
-		sv = 120;
-	}	
-				    
-	//Clear bar graph
-	draw_meter_bar(sv, smax, backcolor);
+	int t1, ref = 0, lvl, key = 0;
+	long f = f_vfo[cur_band][cur_vfo];
+	long flo[2], e6[2], e20;
 	
-	//Draw new bar graph in different colors
-	if(sv < 50)
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(4 * FONTWIDTH, FONTHEIGHT, PSTR("AUTO LO"), WHITE, LIGHTBLUE, 1, 1);	
+	show_msg_P(PSTR("Measuring..."));
+	
+	//Passband reference: highest level near center
+	for(t1 = -2; t1 <= 2; t1++)
 	{
-	    draw_meter_bar(0, sv, GREEN);
+		lvl = if_level(f, IF_CENTER + t1 * 500L);
+		if(lvl > ref)
+		{
+			ref = lvl;
+		}
 	}
-	if(sv >= 65 && sv < 89)
+	
+	for(t1 = 0; t1 < 2 && !ptt_tx; t1++)
 	{
-	    draw_meter_bar(0, 65, GREEN);
-	    draw_meter_bar(66, sv, LIGHTYELLOW);
+		flo[t1] = IF_CENTER + (t1 ? IF_SPAN / 2 : -IF_SPAN / 2); //Outside
+		lvl = if_level(f, flo[t1]);
+		if(lvl > ref - 12)
+		{
+			set_lo(sideband);
+			set_vfo(f + f_lo[sideband]);
+			show_msg_P(PSTR("No passband."));
+			while(!get_keys() && !ptt_tx);
+			return;
+		}
+		
+		e6[t1] = if_edge(f, IF_CENTER, flo[t1], ref - 12);
+		if(lvl < ref - 40)
+		{
+			e20 = if_edge(f, e6[t1], flo[t1], ref - 40);
+		}
+		else
+		{
+			e20 = e6[t1] + (t1 ? IF_CARRIER_OFS : -IF_CARRIER_OFS);
+		}
+		flo[t1] = e20;
 	}
-
-	if(sv >= 89)
+	set_lo(sideband);
+	set_vfo(f + f_lo[sideband]);
+	if(ptt_tx)
+	{
+		return;
+	}
+	
+	lcd_putstring_P(0, 8 * FONTHEIGHT, blank_str, WHITE, backcolor, 1, 1);
+	for(t1 = 0; t1 < 2; t1++)
 	{
-	    draw_meter_bar(0, 65, GREEN);
-	    draw_meter_bar(66, 89, LIGHTYELLOW);
-	    draw_meter_bar(89, sv, LIGHTRED);
+		lcd_putstring_P(0, (t1 + 3) * FONTHEIGHT, sb_str[t1], WHITE, backcolor, 1, 1);
+		lcd_putnumber(5 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, flo[t1], -1, LIGHTYELLOW, backcolor, 1, 1);
 	}
-    
-	if(sv > smax)
+	lcd_putstring_P(0, 6 * FONTHEIGHT, PSTR("BW"), WHITE, backcolor, 1, 1);
+	lcd_putnumber(5 * FONTWIDTH, 6 * FONTHEIGHT, e6[1] - e6[0], -1, WHITE, backcolor, 1, 1);
+	lcd_putstring_P(10 * FONTWIDTH, 6 * FONTHEIGHT, PSTR("Hz"), WHITE, backcolor, 1, 1);
+	
+	while(!key && !ptt_tx)
 	{
-		smax = sv;
-		runseconds10s = runseconds10;
-	}	
+		key = get_keys();
+	}
 	
-	sv_old = sv;   
-}
+	if(key == 2)
+	{
+		for(t1 = 0; t1 < 2; t1++)
+		{
+			f_lo[t1] = flo[t1];
+			CONFIG_SAVE(f_lo[t1], f_lo[t1]);
+		}
+		set_lo(sideband);
+		set_vfo(f + f_lo[sideband]);
+	}
+}	
 
-void clear_smax(void)
+//TX/RX changeover after PTT event, synthesizer first, display afterwards
+void ptt_changeover(void)
 {
-	//Clear bar graph
-	draw_meter_bar(smax - 1, 132, backcolor);
-	smax = 0;
-}
+	int vfo = cur_vfo;
 	
-void draw_meter_scale(int meter_type)
-{
-	int y = 7 * FONTHEIGHT;
-	lcd_putstring(0, y, "               ", LIGHTYELLOW, backcolor, 1, 1);
-	if(!meter_type)
-    {
-        lcd_putstring2(0, y, "S13579", LIGHTGREEN, backcolor, 3); //, 1, 1);
-        lcd_putstring2(65, y, "+10", LIGHTYELLOW, backcolor, 0); //, 1, 1);
-        lcd_putstring2(89, y, "+20dB", LIGHTRED, backcolor, 0); //, 1, 1);
-    }
-    else
-    {
-        lcd_putstring(0, y, "0 2  4  6  8 10W", LIGHTYELLOW, backcolor, 1, 1);
-    }
+	ptt_event = 0;
+	txrx = ptt_tx;
+	
+	if(split)
+	{
+		vfo ^= txrx; //TX on the other VFO
+		set_vfo(f_vfo[cur_band][vfo] + f_lo[sideband]);
+	}
+	else
+	{
+		si5351_write_regs(SYNTH_MS_1, vfo_regs[txrx]); //RIT/XIT: precomputed image
+	}
+	
+	if(!UI_ON_MAIN) //Redrawn when screen closes
+	{
+		return;
+	}
+	draw_meter_scale(txrx);
+	if(split)
+	{
+		show_frequency1(f_vfo[cur_band][vfo], 2);
+	}
 }
-
-////////////////////////////////////////////////////
-//               INTERRUPT HANDLERS
-////////////////////////////////////////////////////
-//Rotary encoder
-ISR(PCINT0_vect)
-{ 
-    int gray = (PINB & 0x03);           // Read PB0 and PB1
+
+//Switch to VFO A (0) or B (1) with its stored frequency
+void select_vfo(int vfo)
+{
+	store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]); //Leaving VFO
+	cur_vfo = vfo;
+	show_vfo(cur_vfo, 0);
+	f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); //VFO changed
+	if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))	            
+	{
+		f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
+	}  
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
 	
-    int state = (gray >> 1) ^ gray;         // Convert from Gray code to binary
+	store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
+}
 
-    if (state != laststate)                //Compare states
-    {        
-        tuningknob += ((laststate - state) & 0x03) - 2; // Results in -1 or +1
-        laststate = state;
-        tuningcount++;
-    } 
-	PCIFR |=  (1 << PCIF0); // Clear pin change interrupt flag.
+//Fast QSY to next (dir = 1) or previous (dir = -1) band
+void qsy_band(int dir)
+{
+	store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]); //Leaving band
+	cur_band += dir;
+	if(cur_band > MAXBANDS - 1)
+	{
+		cur_band = 0;
+	}
+	if(cur_band < 0)
+	{
+		cur_band = MAXBANDS - 1;
+	}
+	
+	show_band(cur_band, 0);
+	set_band(cur_band); //Band changed
+	
+	f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); 
+	
+	if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))
+	{
+		f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
+	}	
+		
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    
+	show_frequency1(0, 2);
+	show_frequency1(f_vfo[cur_band][cur_vfo], 2);
+	show_vfo(cur_vfo, backcolor);
+	store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
+	//Load TX gain preset value
+	mcp4725_set_value(tx_preset[cur_band]);
 }
 
-//Timer 1 seconds counter
-ISR(TIMER1_COMPA_vect)
+void e_save(void)
 {
-    runseconds10++; 
-    tuningcount = 0;
-    sleep_disable();
+	show_msg_P(PSTR("Sleepmode."));
+	show_meter(0);
+	ee_flush(); //Write out EEPROM queue before sleeping
+    set_sleep_mode (SLEEP_MODE_STANDBY);
+    sleep_mode();
+    adc_init(); //ADC clock stopped during sleep, restart sampler
+    show_msg_P(PSTR(""));           
 }
 
-//Calculating tuningrate from rev/time unit
-int calc_tuningfactor(void)
+//Set Tune line to 1 (PB3) on main screen, PWR meter keeps running
+void tune_open(void)
 {
-	return (tuningcount * (tuningcount >> 1)); 
-}	
+	ui_screen = UI_TUNE;
+	PORTB |= (1 << PB3);
+	show_msg_P(PSTR("TUNE..."));
+}
 
+//Any key sets Tune line back to 0
+void tune_event(int key, int dir)
+{
+	if(!key)
+	{
+		return;
+	}
+	PORTB &= ~(1 << PB3);
+	show_msg_P(PSTR(""));
+	ui_screen = UI_MAIN;
+}
+		
 //////////////////////
 //
-//   A   D   C   
+//  S C H E D U L E R
 //
 /////////////////////
-//Read ADC value
-int get_adc(int adc_channel)
+//Run highest priority task that is due, sleep until next IRQ if none is.
+//Run time is measured in ms ticks, a start later than one period is an overrun
+//and missed periods are skipped, not caught up
+void sched_run(void)
 {
+	int t1;
+	unsigned int t0;
 	
-	int adc_val = 0;
-	
-	ADMUX = (1<<REFS0) + adc_channel;     // Kanal adcmode aktivieren
-    _delay_ms(1);
-	
-    ADCSRA |= (1<<ADSC);
-    
-	_delay_ms(1);
+	for(t1 = 0; t1 < TASKS; t1++)
+	{
+		if((int) (get_ms() - tasks[t1].due) >= 0)
+		{
+			break;
+		}
+	}
 	
-	adc_val = ADCL;
-    adc_val += ADCH * 256;   
+	if(t1 == TASKS)
+	{
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();
+		return;
+	}
 	
-	return adc_val;
+	t0 = get_ms();
+	if(t0 - tasks[t1].due >= tasks[t1].period && tasks[t1].overruns < 255)
+	{
+		tasks[t1].overruns++;
+	}
+	tasks[t1].run();
+	if(get_ms() - t0 > tasks[t1].t_max)
+	{
+		tasks[t1].t_max = get_ms() - t0;
+	}
 	
+	tasks[t1].due += tasks[t1].period;
+	if((int) (get_ms() - tasks[t1].due) >= 0)
+	{
+		tasks[t1].due = get_ms() + tasks[t1].period;
+	}
 }	
 
-int get_s_value(void)
+//TX/RX changeover has priority over everything else
+void task_ptt(void)
 {
-	int adcv = get_adc(1); 
-	
-	//lcd_putnumber(0 * FONTWIDTH, 2 * FONTHEIGHT, adcv, -1, WHITE, BLACK, 1, 1);	
-		
-	adcv -= 300;	
-	if(adcv < 0)
+	if(ptt_event)
 	{
-		adcv = 0;
-	}	
-	
-	return (adcv);
+		ptt_changeover();
+	}
 }	
 
-int get_pa_temp(void)
+//Rotary encoder, open screens get it thru task_keys
+void task_tune(void)
 {
-	int adc = get_adc(3);
-	double ux = (double) (5 * adc) / 1023;
-    double rx = 1000 / (5 / ux - 1);
-	double temp = (rx - 815) / 8.81;
+	long ftmp;
 	
-	return (int) temp;
+	if(ui_screen != UI_MAIN)
+	{
+		return;
+	}
+    ftmp = tune_frequency(f_vfo[cur_band][cur_vfo]);
+    if(ftmp)
+    {
+		f_vfo[cur_band][cur_vfo] = ftmp;
+	    set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    
+		show_frequency1(f_vfo[cur_band][cur_vfo], 2);
+	}
 }	
 
-//////////////////////////////
-//
-//    EEPROM-Functions
-//
-//////////////////////////////
-/*
-//Byte 64..67: VFOA on 80
-//Byte 68..71: VFOB on 80
-//Byte 72..75: VFOA on 40
-//Byte 76..79: VFOB on 40
-//Byte 80..83: VFOA on 20
-//Byte 84..87: VFOB on 20
-//Byte 88..91: VFOA on 15
-//Byte 92..95: VFOB on 15
-//Byte 96..99: VFOA on 10
-//Byte 100..103: VFOB on 10
-//VFO data offset = 32
-*/
-//Load and store frequency from EEPROM based on VFO
-long load_frequency(int vfo, int band)
+//Menu actions, called with item number
+void menu_band(int band)
 {
-    long rf;
-    unsigned char hmsb, lmsb, hlsb, llsb;
-    int start_adr = vfo * 4 + band * 8 + OFF_FREQ_DATA;
-		
-    cli();
-    hmsb = eeprom_read_byte((uint8_t*)start_adr);
-    hlsb = eeprom_read_byte((uint8_t*)start_adr + 1);
-    lmsb = eeprom_read_byte((uint8_t*)start_adr + 2);
-    llsb = eeprom_read_byte((uint8_t*)start_adr + 3);
-	sei();
-	
-    rf = (long) 16777216 * hmsb + (long) 65536 * hlsb + (unsigned int) 256 * lmsb + llsb;
-		
-	return rf;
-}
+	store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]); //Leaving band
+    cur_band = band;  //BAND
+    set_band(cur_band); //Band changed
+    if(is_band_freq(load_frequency(cur_vfo, cur_band), cur_band))
+    {
+        f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); 	 
+    }    
+    else
+    {
+        f_vfo[cur_band][cur_vfo] = c_freq[cur_band]; 	 
+    }
+    set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
+    store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
+    //Load TX gain preset value
+    mcp4725_set_value(tx_preset[cur_band]);
+}	
 
-void store_frequency(int vfo, int band, long f)
+void menu_att(int i)
 {
-    long hiword, loword;
-    unsigned char hmsb, lmsb, hlsb, llsb;
-	
-    int start_adr = vfo * 4 + band * 8 + OFF_FREQ_DATA;
-    
-	cli();
-    hiword = f >> 16;
-    loword = f - (hiword << 16);
-    hmsb = hiword >> 8;
-    hlsb = hiword - (hmsb << 8);
-    lmsb = loword >> 8;
-    llsb = loword - (lmsb << 8);
-
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr, hmsb);
-
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 1, hlsb);
-
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 2, lmsb);
-
-    while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr + 3, llsb);
-    
-    sei();	
-	
-}
+	rx_att = i;
+	set_att(rx_att);
+	CONFIG_SAVE(rx_att, rx_att);
+}	
 
-int load_vfo(int xband)
+void menu_dual_watch(int i)
 {
-	int start_adr = xband + OFF_VFO_DATA;
-	int r = eeprom_read_byte((uint8_t*)start_adr);
-	
-	if((r == 0) || (r == 1))
-	{	
-		return(r);
-	}
-	return(-1);	
+	dual_watch();
 }	
 
-void store_vfo(int xband, int xvfo)
+void menu_sideband(int sb)
 {
-	int start_adr = xband + OFF_VFO_DATA;
-	while(!eeprom_is_ready());
-    eeprom_write_byte((uint8_t*)start_adr, xvfo);
-}
+	sideband = sb;     
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    			
+	set_lo(sideband);
+}	
 
-int load_band(void)
+void menu_if_sweep(int i)
 {
-	int start_adr = OFF_LAST_BAND_USED;
-	int r = eeprom_read_byte((uint8_t*)start_adr);
-	
-	if((r >= 0) && (r <= 4))
-	{	
-		return(r);
-	}
-	return(-1);	
+	if_sweep();
 }	
 
-//Save frequency, band, VFO and sideband
-void store_current_operation(int cband, int cvfo, int sband, long frequency)
+void menu_autolo(int i)
 {
-    eeprom_write_byte(OFF_LAST_BAND_USED, cband); //Store current band
-	store_vfo(cband, cvfo); //Store current VFO
-	eeprom_write_byte((uint8_t*)OFF_LAST_SIDEBAND_USED, (uint8_t)sband); //Store current sideband
-	store_frequency(cvfo, cband, frequency);	
+	if_autolo();
 }	
 
-//////////////////////////////
-//
-//    M   E   N   U
-//
-//////////////////////////////
-//Read keys via ADC0
-int get_keys(void)
+void menu_tone(int i)
 {
+	cur_tone = i;     
+	set_tone(cur_tone);
+	CONFIG_SAVE(tone, cur_tone);
+}	
 
-    int key_value[] = {39, 76, 103, 135};
-    int t1;
-    int adcval = get_adc(0);
-        
-    //TEST display of ADC value 
-    /*
-    lcd_putstring(0, 5, "    ", 0, 0);    
-    oled_putnumber(0, 5, adcval, -1, 0, 0);    
-   	*/
-    for(t1 = 0; t1 < 4; t1++)
-    {
-        if(adcval > key_value[t1] - 10 && adcval < key_value[t1] + 10)
-        {
-             return t1 + 1;
-        }
-    }
-    return 0;
-}
-
-//Draw frame
-void lcd_drawbox(int x0, int y0, int x1, int y1)
+//f0..f1 (0) or FAST (4)
+void menu_scan(int i)
 {
-	int t1;
+	long ftmp;
 	
-	for(t1 = y0; t1 < y1 + 1; t1++)
+	if(!i)
 	{
-		lcd_putchar(x0 * FONTWIDTH, t1 * FONTHEIGHT, 0x82, WHITE, backcolor, 1, 1);
-		lcd_putchar(x1 * FONTWIDTH, t1 * FONTHEIGHT, 0x82, WHITE, backcolor, 1, 1);
+		ftmp = scan_f0_f1();
 	}
-	
-	for(t1 = x0 + 1; t1 < x1; t1++)
+	else
 	{
-		lcd_putchar(t1 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x83, WHITE, backcolor, 1, 1);
-		lcd_putchar(t1 * FONTWIDTH, (y1 + 1)  * FONTHEIGHT, 0x83, WHITE, backcolor, 1, 1);
+		ftmp = scan_coarse_fine(); //FAST
 	}
-	
-	//The "Cornerstones"
-	lcd_putchar(x0 * FONTWIDTH, (y1 + 1) * FONTHEIGHT, 0x84, WHITE, backcolor, 1, 1);
-	lcd_putchar(x1 * FONTWIDTH, (y1 + 1) * FONTHEIGHT, 0x85, WHITE, backcolor, 1, 1);
-	lcd_putchar(x0 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x86, WHITE, backcolor, 1, 1);
-	lcd_putchar(x1 * FONTWIDTH, (y0 - 1) * FONTHEIGHT, 0x87, WHITE, backcolor, 1, 1);
-}
-		
-void print_menu_head(char *head_str0, int m_items)
-{	
-    int xpos0 = (16 - strlen(head_str0)) / 2;
-	int ypos0 = 1;
-	char *bstr;
-	int t1;
-	
-	bstr = malloc(17);
-	for(t1 = 0; t1 < 17; t1++)
-	{
-		bstr[t1] = 0;
-	}	
-	for(t1 = 0; t1 < 16; t1++)
+	if(is_band_freq(ftmp, cur_band)) //Freq OK => set VFO
 	{
-		bstr[t1] = 32;
+		f_vfo[cur_band][cur_vfo] = ftmp;
+		set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
 	}	
-			
-	//lcd_cls0(backcolor);	
-	lcd_drawbox(4, 3, 13, 3 + m_items);
-	lcd_putstring(0, ypos0 * FONTHEIGHT, bstr, WHITE, LIGHTBLUE, 1, 1);	
-	lcd_putstring(xpos0 * FONTWIDTH, ypos0 * FONTHEIGHT, head_str0, WHITE, LIGHTBLUE, 1, 1);	
-	
-	free(bstr);
-}
+}	
 
-void print_menu_item(int m, int i, int invert)
-{    
-    char *menu_str[MENUSTRINGS][MENUITEMS] =  {{"80m    ", "40m    ", "20m    ", "17m    ", "15m    "},
-		                                       {"OFF    ", "ON     ", "       ", "       ", "       "}, 
-		                                       {"VFO A  ", "VFO B  ", "       ", "       ", "       "}, 
-	                                           {"LSB    ", "USB    ", "       ", "       ", "       "},
-	                                           {"LO     ", "HI     ", "       ", "       ", "       "},
-	                                           {"f0..f1 ", "VFO A/B", "THRESH ", "       ", "       "},
-	                                           {"OFF    ", "ON     ", "       ", "       ", "       "},
-	                                           {"FAST   ", "SLOW   ", "       ", "       ", "       "},
-	                                           {"SET LSB", "SET USB", "TX GAIN", "SLEEP  ", "TUNE   "}};
-	int xpos1 = 40;
-		
-	if(invert)
-	{
-		lcd_putstring(xpos1, (i + 3) * FONTHEIGHT, menu_str[m][i], BLACK, WHITE, 1, 1);
-	}
-	else
+void menu_scan_vfo(int i)
+{
+	long ftmp = scan_vfoa_vfob();
+	
+	if(ftmp & (0xFFFFFFF))
 	{
-		lcd_putstring(xpos1, (i + 3) * FONTHEIGHT, menu_str[m][i], WHITE, backcolor, 1, 1);
+		cur_vfo = (ftmp >> 28);
+		show_vfo(cur_vfo, backcolor);
+		f_vfo[cur_band][cur_vfo] = ftmp & 0xFFFFFFF;
+		set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
 	}	
-}
-	
-//Print the itemlist and higlight certain item (-1 = NO highlight)
-void print_menu_item_list(int menu, int item)
+}	
+
+void menu_thresh(int i)
 {
-	int t1;
-    
-    for(t1 = 0; t1 < menu_items[menu] + 1; t1++)
-	{
-	    if(t1 == item)
-		{
-		    print_menu_item(menu, t1, 1);   
-		}
-		else
-		{
-		    print_menu_item(menu, t1, 0);   
-		}   
-	}
-}
+	thresh_open();
+}	
 
-//Returns menu_pos if OK or -1 if aborted
-int navigate_thru_item_list(int menu, int maxitems, int high_item)
+void menu_mem_scan(int i)
 {
-	int mpos = high_item;
-	int key;
-	
-	print_menu_item_list(menu, high_item);     //Print item list an dhighlight defined item
-	
-	while(get_keys());
-	
-	key = get_keys();
-	
-    while(key == 0)
-	{
-		if(tuningknob > 2) //Turn CW
-		{
-			print_menu_item(menu, mpos, 0); //Write old entry in normal color
-		    if(mpos < maxitems)
-		    {
-				mpos++;
-			}
-			else	
-			{
-				mpos = 0;
-			}
-			print_menu_item(menu, mpos, 1); //Write new entry in reverse color
-		    tuningknob = 0;
-		}
+	memory_scan();
+}	
 
-		if(tuningknob < -2)  //Turn CCW
-		{    
-		    print_menu_item(menu, mpos, 0); //Write old entry in normal color
-		    if(mpos > 0)
-		    {
-				mpos--;
-			}
-			else	
-			{
-				mpos = maxitems;
-			}
-			print_menu_item(menu, mpos, 1); //Write new entry in reverse color
-		    tuningknob = 0;
-		}	
-		
-		//Preview settings
-		switch(menu)
-		{
-			case 1:	set_att(mpos);
-			        break;
-			        
-			case 2:  //VFO
-			        set_vfo(f_vfo[cur_band][mpos] + f_lo[sideband]);
-			        lcd_putnumber(FONTWIDTH * 4, FONTHEIGHT * 6, f_vfo[cur_band][mpos] / 100, 1, WHITE, backcolor, 1, 1);
-			        break;
-			        
-			case 3: set_lo(mpos);
-			        break;      
-			
-			case 4: set_tone(mpos);
-			        break;      
-		        
-		
-		    case 7: set_agc(mpos); //AGC
-		            break;
-	    }
-	    key = get_keys();
+void menu_split(int i)
+{
+	split = i;
+	show_split(split, backcolor);
+}	
+
+void menu_agc(int i)
+{
+	agc = i;
+	set_agc(agc);
+	CONFIG_SAVE(agc, agc);
+}	
+
+void menu_tx_preset(int i)
+{
+	show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, 0, split);     
+	tx_preset_open();
+}	
+
+void menu_sleep(int i)
+{
+	show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, 0, split);     
+	e_save();
+}	
+
+void menu_tune(int i)
+{
+	ui_close();
+	tune_open();
+}	
+
+void menu_ritxit_off(int i)
+{
+	rit = 0; //RIT/XIT off
+	xit = 0;
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+}	
+
+void menu_recall(int i)
+{
+	mem_recall_open();
+}	
+
+void menu_store(int i)
+{
+	if(mem_store() < 0)
+	{
+		show_msg_P(PSTR("Memory full."));
 	}
-	set_lo(sideband);
-		
-	switch(key)
-	{   case 1: return -1;       //Next menu!
-		        break;
-	    case 2: return mpos; //OK
-	            break;
-	    case 3: return -3;       //Quit menu!
-	            break;
+	else
+	{
+		show_msg_P(PSTR("Memory stored."));
 	}
-	
-	return -1;
 }	
 
+void menu_hits(int i)
+{
+	hits_open();
+}	
 
-//Calculate coordinates
-int menu0_get_xp(int x)
+void menu_histo(int i)
 {
-	return x * FONTWIDTH * 8 + 2 * FONTWIDTH;
+	hist_open();
 }	
 
-int menu0_get_yp(int y)
+void menu_xband(int i)
 {
-	return (y + 2) * FONTHEIGHT;
+	xband_open();
 }	
 
-//Preselection menu
-long menu0(long f, int c_vfo)
+void menu_tasks(int i)
 {
-	int x, y, c = 0;
-	int key = 0;
-	int forecolor = WHITE;
-	char menu_str[MENUSTRINGS][8] = {"BAND", "ATT ", "VFO ", "SIDE", "TONE", "SCAN", "SPLT", "AGC ", "ADJ "};
-	
-	while(get_keys());
-	
-	lcd_cls0(backcolor);
-	
-	lcd_putstring(0, 1, "   MENU SELECT   ", YELLOW, LIGHTGRAY, 1, 1);
+	task_show_open();
+}	
+
+//Keys and encoder steps go to the open screen, on main screen keys call functions
+void task_keys(void)
+{
+	int key;
+	int dir = 0;
 	
-	//Draw init screen
-	for(y = 0; y < 5; y++)
-	{
-		for(x = 0; x < 2; x++)
+    key = get_key_event();    
+    
+    if(ui_screen != UI_MAIN)
+    {
+		if(tuningknob > 2) //Turn CW
 		{
-			if(c < 9)
-			{
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], forecolor, backcolor, 1, 1);
-			    c++;
-			}    
+			dir = 1;
+			tuningknob = 0;
+		}
+		if(tuningknob < -2) //Turn CCW
+		{
+			dir = -1;
+			tuningknob = 0;
+		}
+		if(key & 0xF0) //Screens take short presses only
+		{
+			key = 0;
+		}
+		if(key || dir)
+		{
+			ui_event(key, dir);
 		}
+		return;
 	}
-	
-	c = 0;
-	y = c / 2;
-	x = c - (y * 2);
-	lcd_drawbox(1, 2, 14, 6);
-	lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], backcolor, forecolor , 1, 1);
-		
-	//Select item
-	while(!key)
-	{
-		
-		if(tuningknob > 2)  
-		{
-			if(c < (MENUSTRINGS - 1))
-			{   
-				y = c / 2;
-			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], forecolor, backcolor, 1, 1);
-				c++; 
-		        y = c / 2;
-			    x = c - (y * 2) + 2 * FONTWIDTH;
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], DARKBLUE, WHITE, 1, 1);
-			}   
-			tuningknob = 0;  
-		}	
-		
-		if(tuningknob < -2)  
-		{   
-			if(c > 0)
-			{    
-				y = c / 2;
-			    x = c - (y * 2);
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], forecolor, backcolor, 1, 1);
-			    c--;
-		        y = c / 2;
-			    x = c - (y * 2) + 2 * FONTWIDTH;
-			    lcd_putstring(menu0_get_xp(x), menu0_get_yp(y), menu_str[c], DARKBLUE, WHITE, 1, 1);
-			}    
-			tuningknob = 0; 
-		}	
-		/*
-		if((tuningknob > 2) || (tuningknob < -2))
-		{
-		    lcd_putnumber(0, 8 * FONTHEIGHT, c, -1, WHITE, backcolor, 1, 1);
-		    lcd_putnumber(30, 8 * FONTHEIGHT, c_old, -1, WHITE, backcolor, 1, 1);
-		}
-		* */	
-		
-		key = get_keys();
+    
+    if(key == 1)
+    {
+		//Save current VFO,frequency etc.
+		store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
 		
-		switch(key)
-		{
-			case 0: break;
-			case 2: return menu1(f, c_vfo, c);    
-			        break;
-			default:return -2;
-		}	        
+		menu0_open();
+    }     
+    
+    //Store current frequency setting
+    if(key == 2)		
+    {
+		store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
+		show_msg_P(PSTR("Storing OK."));
+    }	
+
+    if(key == 3)		
+    {
+		tx_preset_open();
+    }	
+    
+    //Second functions on long press: VFO A/B, ATT, AGC
+    if(key == (1 | KEY_EV_LONG))
+    {
+		select_vfo(cur_vfo ^ 1);
+		show_frequency1(f_vfo[cur_band][cur_vfo], 2);
 	}
 	
-	while(get_keys());		
+    if(key == (2 | KEY_EV_LONG))
+    {
+		rx_att ^= 1;
+		set_att(rx_att);
+		show_att(rx_att);
+		CONFIG_SAVE(rx_att, rx_att);
+	}
 	
-	return -2; 
+    if(key == (3 | KEY_EV_LONG))
+    {
+		agc ^= 1;
+		set_agc(agc);
+		show_agc(agc);
+		CONFIG_SAVE(agc, agc);
+	}
+    	    	
+    //Fast QSY to next band, hold key 4 to step down
+    if(key == 4)		
+    {
+		qsy_band(1);
+    }		
+    
+    if(key == (4 | KEY_EV_LONG) || key == (4 | KEY_EV_REPEAT))		
+    {
+		qsy_band(-1);
+    }
 }	
-	
-			
-long menu1(long f, int c_vfo, int menu)
+
+//VOLTS and TEMPERATURE measurement
+void task_sensors(void)
 {
-	int result = 0;
-	char menu_str[MENUSTRINGS][10] = {"BAND SET", "RX ATT", "VFO", "SIDEBAND", "TONE", "SCAN", "SPLIT", "AGC", "ADJUST"};
-	
-	lcd_cls0(backcolor);	
-		
-	while(get_keys());
-	
-	//Navigate thru item list
-	
-	
-	print_menu_head(menu_str[menu], menu_items[menu]);	//Head outline of menu
-	switch(menu)
-	{           //Print item list in full with diff. preset values
-	    case 0: print_menu_item_list(menu, cur_band);  //BAND
-	            result = navigate_thru_item_list(menu, menu_items[menu], cur_band);
-	            break; 
-	    case 1: print_menu_item_list(menu, rx_att);   //RX ATT
-	            result = navigate_thru_item_list(menu, menu_items[menu], rx_att);
-	            break; 
-	    case 2: print_menu_item_list(menu, cur_vfo);  //VFO
-	            result = navigate_thru_item_list(menu, menu_items[menu], cur_vfo);	    
-	            break; 
-	    case 3: print_menu_item_list(menu, sideband); //Sideband
-	            result = navigate_thru_item_list(menu, menu_items[menu], sideband);	    
-	            break;
-	    case 4: print_menu_item_list(menu, sideband); //Sideband
-	            result = navigate_thru_item_list(menu, menu_items[menu], cur_tone);	    
-	            break; 
-	    case 6: print_menu_item_list(menu, split);    //SPLIT
-	    	    result = navigate_thru_item_list(menu, menu_items[menu], split);
-                break;           
-	    case 7: print_menu_item_list(menu, agc);      //AGC
-	    	    result = navigate_thru_item_list(menu, menu_items[menu], agc);
-	            break;                 
-	    default:print_menu_item_list(menu, 0);         //RX SCAN + ADJUST
-	    	    result = navigate_thru_item_list(menu, menu_items[menu], 0);
-	}   
-	
-	if(result > -1)
+	if(!UI_ON_MAIN)
+	{
+		return;
+	}
+	adc_v = get_voltage();
+	if(adc_v != adc_v_old)
+	{
+		show_voltage(adc_v);
+		adc_v_old = adc_v;
+	}
+	show_pa_temp();
+}	
+
+//S-Meter resp. PWR meter
+void task_meter(void)
+{
+	if(!UI_ON_MAIN)
+	{
+		return;
+	}
+	if(!txrx)
 	{
-	   return(menu * 10 + result);
+		show_smeter(); //S-Meter from ADC1 filter stage
 	}
 	else
 	{
-	    switch(result)
-	    {				
-	        case -3: return -3; //Quit menu         
-	                 break;
-	        case -1: break;
-	    }
-    }		
-    
-    lcd_cls1(32, 28, 112, 128, backcolor);
-    
-    return -2; //Nothing to do in main()
-}
+		show_meter(tx_power2px(get_tx_power())); //TX PWR from ADC2
+	}
+}	
 
-long set_lo_frequencies(int sb)
+//Restore start message after message timeout
+void task_msg(void)
 {
-	int key = 0, t1;
-		
-	lcd_cls0(backcolor);	
-    
-	key = 0;	
-		
-	for(t1 = 0; t1 < 16; t1++)
+	if(ui_screen == UI_TASKS)
 	{
-	   lcd_putchar(t1 * FONTWIDTH, 1 * FONTHEIGHT, 32, WHITE, LIGHTBLUE, 1, 1);	
-	}   
-	lcd_putstring(2 * FONTWIDTH, 1 * FONTHEIGHT, "LO SET MODE", WHITE, LIGHTBLUE, 1, 1);	
-	
-	if(!sb)
+		task_show_refresh();
+		return;
+	}
+	if(ui_screen != UI_MAIN) //Open screens on main screen prompt in message line
 	{
-	    lcd_putstring(3 * FONTWIDTH, 2 * FONTHEIGHT, " fLO LSB ", WHITE, BLUE, 1, 1);
+		return;
 	}
-	else    
+	if(runseconds10 > runseconds10msg + 60 && msgstatus)
 	{
-	    lcd_putstring(3 * FONTWIDTH, 2 * FONTHEIGHT, " fLO USB ", WHITE, BLUE, 1, 1);
+		show_msg_P(PSTR("Mini5 DK7IH 2020"));    
+		runseconds10msg = runseconds10;
+		msgstatus = 0;
 	}
+}	
+
+//Period, worst case run time and overruns per task. Counters are saved before
+//the screen is drawn and restart after that, so drawing it is not counted.
+//Values include this screen's refresh, charged to MSG
+void task_show_open(void)
+{
+	int t1;
 	
-	while(get_keys());
-	
-	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sb]);   
-	si5351_set_freq(SYNTH_MS_0, f_lo[sb]);
-	show_frequency1(f_lo[sb], 1);
-	
-	while(!key)
+	for(t1 = 0; t1 < TASKS; t1++)
 	{
-		if(tuningknob > 2)  
-		{    
-		    f_lo[sb] += 10;
-		    tuningknob = 0;
-		    si5351_set_freq(SYNTH_MS_0, f_lo[sb]);
-			show_frequency1(f_lo[sb], 1);
-		}	
-		
-		if(tuningknob < -2)  
-		{    
-		    f_lo[sb] -= 10;
-			tuningknob = 0;
-			si5351_set_freq(SYNTH_MS_0, f_lo[sb]);
-			show_frequency1(f_lo[sb], 1);
-		}	
-		
-		key = get_keys();    
-	}	
-	
-	while(get_keys());
+		task_max_snap[t1] = tasks[t1].t_max;
+		task_ovr_snap[t1] = tasks[t1].overruns;
+	}
 	
-	if(key != 2)
+	ui_screen = UI_TASKS;
+	ui_val = 1; //Counters restart on first refresh
+	lcd_cls0(backcolor);
+	lcd_putstring_P(0, FONTHEIGHT, blank_str, WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(5 * FONTWIDTH, FONTHEIGHT, PSTR("TASKS"), WHITE, LIGHTBLUE, 1, 1);	
+	lcd_putstring_P(6 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("ms"), LIGHTGRAY, backcolor, 1, 1);	
+	lcd_putstring_P(10 * FONTWIDTH, 2 * FONTHEIGHT, PSTR("max ovr"), LIGHTGRAY, backcolor, 1, 1);	
+	for(t1 = 0; t1 < TASKS; t1++)
 	{
-        return 0;
-    }
-    else
-    {
-        return f_lo[sb];
-    }    
-}
+		lcd_putstring_P(0, (t1 + 3) * FONTHEIGHT, task_str[t1], WHITE, backcolor, 1, 1);	
+		lcd_putnumber(6 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, tasks[t1].period, -1, LIGHTGRAY, backcolor, 1, 1);
+	}
+}	
 
-void e_save(void)
+//Called by task_msg every 500ms, new counters are merged into the saved ones
+//and restart, only changed values are redrawn. 3 digits fit, t_max stops at 999
+void task_show_refresh(void)
 {
-	show_msg("Sleepmode.");
-	show_meter(0);
-    set_sleep_mode (SLEEP_MODE_STANDBY);
-    sleep_mode();
-    show_msg("");           
-}
+	int t1, ovr;
+	
+	for(t1 = 0; t1 < TASKS; t1++)
+	{
+		ovr = task_ovr_snap[t1] + tasks[t1].overruns;
+		if(ovr > 255)
+		{
+			ovr = 255;
+		}
+		if(ui_val) //First refresh drops counts from opening the screen
+		{
+			tasks[t1].t_max = 0;
+			ovr = task_ovr_snap[t1];
+		}
+		if(ui_val || tasks[t1].t_max > task_max_snap[t1])
+		{
+			if(tasks[t1].t_max > task_max_snap[t1])
+			{
+				task_max_snap[t1] = tasks[t1].t_max;
+			}
+			lcd_putnumber_r(10 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, (task_max_snap[t1] > 999) ? 999 : task_max_snap[t1], -1, 3, WHITE, backcolor, 1, 1);
+		}
+		if(ui_val || ovr != task_ovr_snap[t1])
+		{
+			task_ovr_snap[t1] = ovr;
+			lcd_putnumber_r(13 * FONTWIDTH, (t1 + 3) * FONTHEIGHT, ovr, -1, 3, (ovr) ? LIGHTRED : WHITE, backcolor, 1, 1);
+		}
+		tasks[t1].t_max = 0;
+		tasks[t1].overruns = 0;
+	}
+	ui_val = 0;
+}	
 
-//Set Tune line to 1 (PB3)
-void tune(void)
+//Any key resets the counters and closes
+void task_show_event(int key, int dir)
 {
-	int key = 0;
-	PORTB |= (1 << PB3);
-	while(get_keys());
-	while(!key)
+	int t1;
+	
+	if(!key)
 	{
-		key = get_keys();
+		return;
 	}
-	PORTB &= ~(1 << PB3);
-}
-		
+	for(t1 = 0; t1 < TASKS; t1++)
+	{
+		tasks[t1].t_max = 0;
+		tasks[t1].overruns = 0;
+	}
+	ui_close();
+}	
+
 int main(void)
 {
-	int t1;
-	int m;
-	long runseconds10s2 = runseconds10;
-	long ftmp;
-		
 	backcolor = BLACK;
         		
-	//Variables runtime
-	int key = 0;
-		    
-    //Volts measurement
-    int adc_v;
-    int adc_v_old = 0;
-    long runseconds10volts = -50;
-    double v1;
-    
-   	//Meter
-    int sval0 = 0;
-    int sval1 = 0;    
-    
-    //TX/RX indicator
-	int txrx = 0;
 		
     DDRD = 0xFF;   //Relay driver 0:2, LCD 3:7
     DDRB |= (1 << PB2); //Relay for 20dB RX ATT
@@ -2638,8 +5444,7 @@ int main(void)
 	PORTB = (1 << PB0)|(1 << PB1); //rotary encoder
 	
 	//ADC config and ADC init
-    ADCSRA = (1<<ADPS0) | (1<<ADPS1) | (1<<ADEN); //Prescaler 64 and ADC on
-	get_adc(0); //One dummy conversion
+	adc_init();
 
 	//Interrupt definitions for rotary encoder  
 	PCICR |= (1 << PCIE0);                     // enable pin change interupt
@@ -2654,17 +5459,20 @@ int main(void)
 	OCR1AH = (1563 >> 8);                             //Load compare values to registers
     OCR1AL = (1563 & 0x00FF);
 	TIMSK1 |= (1<<OCIE1A);
+	
+	//Timer 0 as 1ms tick for key scanner
+	TCCR0A = (1 << WGM01);              //CTC mode
+	TCCR0B = (1 << CS01) | (1 << CS00); //Prescaler = 1/64 => 250000 incs/sec
+	OCR0A = 249;                        //250 incs = 1ms
+	TIMSK0 |= (1 << OCIE0A);
+	
+	//Interrupts on, ADC sampler needs one round (< 1ms) to fill adc_val[]
+	sei();
+	_delay_ms(2);
 				
     //RESET PORTD D0:D2 relay bcd decoder
     set_band(-1);
     
-    //Allocate display buffer for text output
-    oldbuf = malloc(0x10);	
-    for(t1 = 0; t1 < 0x10; t1++)
-	{
-		*(oldbuf + t1) = 0;
-	}	
-		
     //TWI
 	twi_init();
 	
@@ -2676,38 +5484,40 @@ int main(void)
     //VFO and LO start
     si5351_start();
     
-    //Load start values
-    //BAND
-    cur_band = load_band();
-    if(cur_band == -1)
+    //Load settings and memory channel index
+    config_load();
+    mem_index_build();
+    
+    //Load start values from state log, old fixed locations if log is empty
+    if(!load_current_operation())
     {
-		cur_band = 2; //Default 20m
-	}
-	//VFO	
-	cur_vfo = load_vfo(cur_band);	
-	if(cur_vfo == -1)
-	{
-        cur_vfo = 0;
-    }
-    //QRG
-	f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band);  
-	if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))
-	{
-	    f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
+        //BAND
+        cur_band = load_band();
+        if(cur_band == -1)
+        {
+		    cur_band = 2; //Default 20m
+	    }
+	    //VFO	
+	    cur_vfo = load_vfo(cur_band);	
+	    if(cur_vfo == -1)
+	    {
+            cur_vfo = 0;
+        }
+        //QRG
+	    f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band);  
+	    if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))
+	    {
+	        f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
+	    }
+	    sideband = std_sideband[cur_band];
 	}
-	sideband = std_sideband[cur_band];
+
 	set_band(cur_band);
 	
-	//Load scan threshold
-    thresh = eeprom_read_byte((uint8_t*)138);          	
-    if(thresh < 0 || thresh > 12)
-    {
-		thresh = 8;
-	}
+
 			
 	//Voltage
-	v1 = (double) get_adc(6) * 5 / 1024 * 6 * 10;
-	adc_v = (int) v1;	
+	adc_v = get_voltage();	
 				
     //VFO ON
     set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    
@@ -2717,320 +5527,22 @@ int main(void)
     set_lo(sideband);
     si5351_set_freq(SYNTH_MS_2, 0); 
     
-    //RX Attenuator
-    rx_att = eeprom_read_byte((uint8_t*)140);          	
-    if(rx_att < 0 || rx_att > 1)
-    {
-		rx_att = 0;
-	}
+    //RX Attenuator, AGC and TONE
     set_att(rx_att);
-    
-    //TONE set
-    cur_tone = eeprom_read_byte((uint8_t*)142);          	
-    if(cur_tone < 0 || cur_tone > 1)
-    {
-		cur_tone = 0;
-	}
+    set_agc(agc);
     set_tone(cur_tone);
 
+
     show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, 0, split);   
     
-    //Load TX preset values
-    for(t1 = 0; t1 < 5; t1++)
-    {
-		tx_preset[t1] = load_tx_preset(t1);
-		if(tx_preset[t1] < 0 || tx_preset[t1] > 4096)
-		{
-			tx_preset[t1] = 2048;
-		}	
-	}	
+    //TX preset of current band
     mcp4725_set_value(tx_preset[cur_band]); 
              
-    sei();    
-    
-    show_msg("Mini5 DK7IH 2020");    
+    show_msg_P(PSTR("Mini5 DK7IH 2020"));    
     
     for(;;) 
 	{
-	       
-        ftmp = tune_frequency(f_vfo[cur_band][cur_vfo]);
-        if(ftmp)
-        {
-			f_vfo[cur_band][cur_vfo] = ftmp;
-		    set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    
-			show_frequency1(f_vfo[cur_band][cur_vfo], 2);
-		}	
-        key = get_keys();    
-        
-        if(key == 1)
-        {
-			//Save current VFO,frequency etc.
-			store_frequency(cur_vfo, cur_band, f_vfo[cur_band][cur_vfo]);
-			store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
-			
-			while(get_keys());
-			m = menu0(f_vfo[cur_band][cur_vfo], cur_vfo);
-			switch(m)
-			{
-				case 0:    
-	            case 1: 
-	            case 2: 
-	            case 3:
-	            case 4:     cur_band = m;  //BAND
-	                        set_band(cur_band); //Band changed
-				            if(is_band_freq(load_frequency(cur_vfo, cur_band), cur_band))
-				            {
-						        f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); 	 
-						    }    
-						    else
-						    {
-						        f_vfo[cur_band][cur_vfo] = c_freq[cur_band]; 	 
-						    }
-			                set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
-                            eeprom_write_byte((uint8_t*)OFF_LAST_BAND_USED, cur_band); //Store current band
-                            //Load TX gain preset value
-                            mcp4725_set_value(tx_preset[cur_band]);
-    
-			                break;
-			                
-			    case 10:    rx_att = 0; //ATT
-			                set_att(rx_att);
-			                eeprom_write_byte((uint8_t*)140, rx_att);
-			                break;    
-			                       
-				case 11:    rx_att = 1;
-			                set_att(rx_att);
-			                eeprom_write_byte((uint8_t*)140, rx_att);
-			                break;  
-	            case 20:    //VFO
-	            case 21:    cur_vfo = m - 20;
-	                        show_vfo(cur_vfo, 0);
-	                        f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); //VFO changed
-                            if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))	            
-                            {
-						        f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
-						    }  
-						    set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
-						    
-			                eeprom_write_byte((uint8_t*)OFF_LAST_VFO_USED, (uint8_t)cur_vfo); //Store current VFO
-			                break;
-			     
-				case 30: 
-	            case 31:    sideband = m - 30;     
-	                        set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    			
-	                        set_lo(sideband);
-	                        break;
-	            
-	            case 40:    //TONE
-	            case 41:    cur_tone = m - 40;     
-	                        set_tone(cur_tone);
-	                        eeprom_write_byte((uint8_t*)142, cur_tone);
-	                        break;
-	                        
-	            case 50:    ftmp = scan_f0_f1(); //SCAN
-	                        if(is_band_freq(ftmp, cur_band)) //Freq OK => set VFO
-	                        {
-								f_vfo[cur_band][cur_vfo] = ftmp;
-								set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
-							}	
-							break;         
-							
-				case 51:    ftmp = scan_vfoa_vfob();
-				            if(ftmp & (0xFFFFFFF))
-				            {
-								cur_vfo = (ftmp >> 28);
-								show_vfo(cur_vfo, backcolor);
-								f_vfo[cur_band][cur_vfo] = ftmp & 0xFFFFFFF;
-								set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);   
-							}	
-							break;
-	                        
-	            case 52:    set_scan_threshold();
-	                        break;              
-	            case 60:    
-	            case 61:    split = m - 60;
-	                        show_split(split, backcolor);
-	                        break;
-	           
-	            case 70:    agc = 0;
-			                set_agc(agc);
-			                eeprom_write_byte((uint8_t*)142, rx_att);
-			                break;    
-			                       
-				case 71:    agc = 1;
-			                set_agc(agc);
-			                eeprom_write_byte((uint8_t*)142, rx_att);
-			                break;   
-			                
-	            case 80: 
-	            case 81:    ftmp = set_lo_frequencies(m - 80);
-	                        if(ftmp > 0)
-	                        {
-								f_lo[m - 80] = ftmp;     
-								set_lo(sideband);
-	                        }
-	                        break;
-	                        
-	            case 82:    tx_preset_adjust();
-	                        break;
-	       
-   	            case 83:    show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, 0, split);     
-   	                        e_save();
-	                        break;
-	                        
-	            case 84:    tune();
-	                        break;
-	                                
-			    
-		    }       
-		    show_all_data(f_vfo[cur_band][cur_vfo], cur_band, sideband, cur_vfo, adc_v, 0, split);     
-        }     
-        
-        //Store current frequency setting
-        if(key == 2)		
-        {
-			while(get_keys());
-			key = 0;
-			store_current_operation(cur_band, cur_vfo, sideband, f_vfo[cur_band][cur_vfo]);
-			show_msg("Storing OK.");
-	    }	
-
-        if(key == 3)		
-        {
-			while(get_keys());
-			key = 0;
-			tx_preset_adjust();
-	    }	
-	    	    	
-        //Fast QSY to next band
-        if(key == 4)		
-        {
-			key = 0;
-			while(get_keys());
-			
-			if(cur_band < MAXBANDS -1)
-			{
-				cur_band++;
-			}
-			else
-			{
-				cur_band = 0;
-			}
-			
-			show_band(cur_band, 0);
-			set_band(cur_band); //Band changed
-		    
-		    for(t1 = 0; t1 < 0x10; t1++)
-			{
-				*(oldbuf + t1) = 0;
-			}	
-			f_vfo[cur_band][cur_vfo] = load_frequency(cur_vfo, cur_band); 
-			
-			if(!is_band_freq(f_vfo[cur_band][cur_vfo], cur_band))
-			{
-				f_vfo[cur_band][cur_vfo] = c_freq[cur_band];
-			}	
-				
-			set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);    
-			show_frequency1(0, 2);
-			show_frequency1(f_vfo[cur_band][cur_vfo], 2);
-			show_vfo(cur_vfo, backcolor);
-			eeprom_write_byte((uint8_t*)OFF_LAST_BAND_USED, cur_band); //Store current band
-			//Load TX gain preset value
-            mcp4725_set_value(tx_preset[cur_band]);
-	    }		
-		
-        //VOLTS and TEMPERATURE measurement
-		if(runseconds10 > runseconds10volts + 10)
-		{
-		    v1 = (double) get_adc(6) * 5 / 1024 * 6 * 10;
-		    adc_v = (int) v1;
-   		    if(adc_v != adc_v_old)
-		    {
-    	        show_voltage(adc_v);
-	     		adc_v_old = adc_v;
-		    }	
-		    
-		    show_pa_temp();
-		    runseconds10volts = runseconds10;
-	    }
-	    
-	    //After 10th second check S-Val resp. PWR value
-	    if(runseconds10 > runseconds10s)
-		{
-			//TX/RX switching check
-		    if(get_adc(7) > 1000) //TX, cause ADC7 is hi
-		    {
-			    if(!txrx)
-			    {
-					txrx = 1;
-				    draw_meter_scale(1);	 
-			        			        			        
-			        if(split)
-			        {
-						if(cur_vfo == 0)
-						{
-			                set_vfo(f_vfo[cur_band][1] + f_lo[sideband]);    
-			                show_frequency1(f_vfo[cur_band][1], 2);
-			            }    
-			            else
-			            {
-			                set_vfo(f_vfo[cur_band][0] + f_lo[sideband]);    
-			                show_frequency1(f_vfo[cur_band][0], 2);
-			            }    
-			        }
-			     }       
-			    
-		    }	 
-		
-		    if(!(get_adc(7) > 1000)) //RX, cause ADC7 lo
-		    {
-			    if(txrx)
-			    {
-				    txrx = 0;
-				    draw_meter_scale(0);
-				    			        
-			        if(split)
-			        {
-						if(cur_vfo == 0)
-						{
-			                set_vfo(f_vfo[cur_band][0] + f_lo[sideband]);    
-			                show_frequency1(f_vfo[cur_band][0], 2);
-			            }    
-			            else
-			            {
-			                set_vfo(f_vfo[cur_band][1] + f_lo[sideband]);    
-			                show_frequency1(f_vfo[cur_band][1], 2);
-			            }    
-			        }
-			    }	 
-		    }
-
-			if(!txrx)
-	        {
-				sval0 = get_s_value(); //ADC voltage on ADC1 SVAL 
-	            show_meter(sval0); //S-Meter		
-			}
-			else
-			{
-			    sval1 = get_adc(2); //TX PWR voltage on ADC2
-				show_meter(sval1 >> 3); //S-Meter		
-			}
-		    runseconds10s = runseconds10;
-		}    
-		
-		if(runseconds10 > runseconds10s2 + 20)
-		{
-			clear_smax();
-			runseconds10s2 = runseconds10;
-		}	
-		
-		if(runseconds10 > runseconds10msg + 60 && msgstatus)
-		{
-			show_msg("Mini5 DK7IH 2020");    
-			runseconds10msg = runseconds10;
-			msgstatus = 0;
-		}	
+		sched_run();
 	}
     return 0;
 }
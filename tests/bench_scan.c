@@ -0,0 +1,222 @@
+//Linear scan (scan_f0_f1) against coarse-to-fine scan (scan_coarse_fine)
+//on a simulated 20m RF scene: SSB stations talking in bursts over noise.
+//Frequency is decoded from the Si5351 register shadow, S-Meter ADC is fed
+//from the scene. Reports synthesizer steps/s without stops and share of
+//fine steps, time per pass, stations found and distance of each stop
+//from the station: make bench
+#include <stdio.h>
+#include <math.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+#define STATIONS 12
+#define RUN_S 300       //Simulated seconds per scan mode
+#define NOISE_DB 10     //Noise floor dB over S0
+#define NOISE_VAR 3     //+/- dB per ADC sample
+#define STOP_US 500000  //VFO on same QRG this long = stop
+
+long st_f[STATIONS];
+int st_db[STATIONS];
+unsigned long st_on[STATIONS], st_off[STATIONS], st_phase[STATIONS]; //Burst timing in ms
+
+int adc_for_db[90];
+unsigned long rnd_state = 7;
+
+//Bench state
+long f_tuned;
+unsigned long t_tuned, t_end;
+unsigned long steps, passes, fine, stops, hold_us;
+int found[STATIONS];
+long err_sum;
+int stop_done;
+
+unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) % n;
+}
+
+//Dial frequency from VFO multisynth register image (AN619)
+long tuned_freq(void)
+{
+	uint8_t *r = si5351_shadow[1];
+	unsigned long p1 = ((unsigned long) (r[2] & 3) << 16) | (r[3] << 8) | r[4];
+	unsigned long p2 = ((unsigned long) (r[5] & 15) << 16) | (r[6] << 8) | r[7];
+	double div = (p1 + 512 + (double) p2 / CFACTOR) / 128;
+	
+	return lround(25000000.0 * PLLRATIO / div) - f_lo[sideband] - rit;
+}
+
+int station_on(int s)
+{
+	return ((host_us / 1000 + st_phase[s]) % (st_on[s] + st_off[s])) < st_on[s];
+}
+
+//S-Meter level of scene at dial frequency f
+int scene_db(long f)
+{
+	int s;
+	double d, db = NOISE_DB, lvl;
+	
+	for(s = 0; s < STATIONS; s++)
+	{
+		d = fabs(f - st_f[s]) / 600.0;
+		if(d < 2.5 && station_on(s))
+		{
+			lvl = st_db[s] - 6 * d * d; //IF filter skirt
+			if(lvl > db)
+			{
+				db = lvl;
+			}
+		}
+	}
+	return (int) db + (int) rnd(2 * NOISE_VAR + 1) - NOISE_VAR;
+}
+
+void record_stop(long f)
+{
+	int s, best = -1;
+	long d, dmin = 3000;
+	
+	stops++;
+	for(s = 0; s < STATIONS; s++)
+	{
+		d = labs(f - st_f[s]);
+		if(d < dmin)
+		{
+			dmin = d;
+			best = s;
+		}
+	}
+	if(best >= 0)
+	{
+		found[best] = 1;
+		err_sum += dmin;
+	}
+}
+
+int bench_adc(int ch)
+{
+	long f;
+	int db;
+	
+	if(ch != 1)
+	{
+		return host_adc_default(ch);
+	}
+	
+	if(host_us >= t_end)
+	{
+		key_put(3); //Stop scan
+	}
+	
+	f = tuned_freq();
+	if(f != f_tuned)
+	{
+		if(stop_done)
+		{
+			hold_us += host_us - t_tuned;
+		}
+		steps++;
+		if(f < f_tuned - 100000)
+		{
+			passes++;
+		}
+		if(labs(f - f_tuned - SCAN_STEP) < 10)
+		{
+			fine++;
+		}
+		f_tuned = f;
+		t_tuned = host_us;
+		stop_done = 0;
+	}
+	else if(!stop_done && host_us - t_tuned > STOP_US)
+	{
+		record_stop(f);
+		stop_done = 1;
+	}
+	
+	db = scene_db(f);
+	if(db < 0)
+	{
+		db = 0;
+	}
+	if(db > 80)
+	{
+		db = 80;
+	}
+	return adc_for_db[db];
+}
+
+void run(const char *name, long (*scan)(void))
+{
+	int s, n = 0;
+	unsigned long t0;
+	
+	steps = passes = fine = stops = hold_us = 0;
+	err_sum = 0;
+	memset(found, 0, sizeof(found));
+	memset(noise_floor, 0xFF, sizeof(noise_floor)); //-1 = no estimate
+	f_tuned = 0;
+	stop_done = 1;
+	
+	t0 = host_us;
+	t_end = host_us + RUN_S * 1000000UL;
+	scan();
+	if(stop_done)
+	{
+		hold_us += host_us - t_tuned;
+	}
+	
+	for(s = 0; s < STATIONS; s++)
+	{
+		n += found[s];
+	}
+	t0 = host_us - t0 - hold_us; //Scanning time without stops
+	printf("%-12s %4.0f steps/s (%2.0f%% fine) %4.1f s/pass %3lu stops %2d/%d stations %4ld Hz avg. stop error\n",
+	       name, steps * 1e6 / t0, fine * 100.0 / steps, passes ? t0 / 1e6 / passes : 0.0,
+	       stops, n, STATIONS, stops ? err_sum / (long) stops : 0);
+	while(get_key_event()); //Drop leftover key events
+}
+
+int main(void)
+{
+	int s, v, db;
+	
+	host_reset();
+	sei();
+	
+	//Inverse of smeter_db()
+	for(db = 0, v = SMETER_OFFSET; db < 90; db++)
+	{
+		while(v < 1023 && smeter_db((v - SMETER_OFFSET) << 5) < db)
+		{
+			v++;
+		}
+		adc_for_db[db] = v;
+	}
+	
+	for(s = 0; s < STATIONS; s++)
+	{
+		st_f[s] = 14010000 + s * 27000 + rnd(10000);
+		st_db[s] = 20 + rnd(35);
+		st_on[s] = 1000 + rnd(4000);
+		st_off[s] = 4000 + rnd(8000);
+		st_phase[s] = rnd(10000);
+	}
+	
+	cur_band = 2;
+	sideband = 1;
+	thresh = 8;
+	f_vfo[2][0] = band_f0[2];
+	f_vfo[2][1] = band_f1[2];
+	host_adc = bench_adc;
+	
+	printf("%d stations 20..55dB over S0, noise %ddB +/-%ddB, squelch %ddB over floor, %ds per mode\n",
+	       STATIONS, NOISE_DB, NOISE_VAR, thresh, RUN_S);
+	run("linear", scan_f0_f1);
+	run("coarse/fine", scan_coarse_fine);
+	
+	return 0;
+}
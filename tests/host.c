@@ -0,0 +1,321 @@
+//Host emulation of the ATmega328P parts Mini5.c uses, see host.h
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "host.h"
+
+//Plain registers
+#define R(x) volatile uint8_t x;
+R(PORTB) R(PORTC) R(DDRB) R(DDRC) R(DDRD) R(PINB) R(PINC) R(PIND)
+R(PCICR) R(PCMSK0) R(PCMSK1) R(PCMSK2) R(PCIFR)
+R(TCCR0A) R(TCCR0B) R(OCR0A) R(TIMSK0) R(TCNT0) R(TIFR0)
+R(TCCR1A) R(TCCR1B) R(OCR1AH) R(OCR1AL) R(TIMSK1)
+R(TCCR2A) R(TCCR2B) R(OCR2A) R(TIMSK2) R(TCNT2)
+R(ADMUX) R(ADCSRA) R(ADCSRB) R(ADCL) R(ADCH) R(DIDR0) R(ACSR)
+R(TWSR) R(TWBR) R(TWCR)
+#undef R
+volatile uint16_t EEAR;
+
+//Firmware IRQ handlers
+void ADC_vect(void);
+void TIMER0_COMPA_vect(void);
+void TIMER1_COMPA_vect(void);
+void EE_READY_vect(void);
+extern volatile uint8_t ee_head, ee_tail;
+
+unsigned long host_us;
+uint8_t host_eeprom[HOST_EE_SIZE];
+unsigned long host_ee_writes[HOST_EE_SIZE];
+unsigned long host_twi_bytes;
+unsigned long host_lcd_bytes;
+uint32_t host_lcd_hash;
+unsigned long host_lcd_byte_us;
+int (*host_adc)(int ch) = host_adc_default;
+
+static volatile uint8_t sreg, eecr, eedr, twdr, portd;
+static uint8_t lcd_old, lcd_byte;
+static int lcd_bits;
+
+//LCD pins on PORTD, as in Mini5.c
+#define LCD_CLOCK 128
+#define LCD_DATA 64
+#define LCD_DC_A0 32
+#define LCD_CS 8
+static unsigned long next_adc, next_t0, next_t1, ee_ready;
+static int in_irq;
+
+int host_adc_default(int ch)
+{
+	switch(ch)
+	{
+		case 0: return 1023; //No key
+		case 1: return 0;    //No signal
+		case 7: return 0;    //RX
+	}
+	return 512;
+}
+
+void host_reset(void)
+{
+	host_us = 0;
+	next_adc = HOST_ADC_US;
+	next_t0 = 1000;
+	next_t1 = 100000;
+	ee_ready = 0;
+	sreg = eecr = eedr = 0;
+	host_twi_bytes = 0;
+	host_lcd_bytes = 0;
+	host_lcd_hash = 2166136261UL;
+	host_lcd_byte_us = 0;
+	lcd_old = lcd_byte = 0;
+	lcd_bits = 0;
+	memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+	memset(host_ee_writes, 0, sizeof(host_ee_writes));
+	host_adc = host_adc_default;
+}
+
+//Byte programming started by EEPE completes at once,
+//EEPROM is ready again for the IRQ after HOST_EE_WRITE_US
+static void ee_commit(void)
+{
+	if(eecr & (1 << 1)) //EEPE
+	{
+		host_eeprom[EEAR % HOST_EE_SIZE] = eedr;
+		host_ee_writes[EEAR % HOST_EE_SIZE]++;
+		eecr &= ~((1 << 1) | (1 << 2));
+		ee_ready = host_us + HOST_EE_WRITE_US;
+	}
+}
+
+//Run all IRQs that are due, if global IRQ flag is set
+static void host_irq(void)
+{
+	int v;
+	
+	if(in_irq || !(sreg & 0x80))
+	{
+		return;
+	}
+	in_irq = 1;
+	sreg &= 0x7F;
+	
+	while(next_adc <= host_us || next_t0 <= host_us || next_t1 <= host_us)
+	{
+		if(next_adc <= next_t0 && next_adc <= next_t1)
+		{
+			v = host_adc(ADMUX & 0x0F);
+			ADCL = v & 0xFF;
+			ADCH = v >> 8;
+			ADC_vect();
+			next_adc += HOST_ADC_US;
+		}
+		else if(next_t0 <= next_t1)
+		{
+			TIMER0_COMPA_vect();
+			next_t0 += 1000;
+		}
+		else
+		{
+			TIMER1_COMPA_vect();
+			next_t1 += 100000;
+		}
+	}
+	
+	while((eecr & (1 << 3)) && ee_ready <= host_us) //EERIE
+	{
+		EE_READY_vect();
+		ee_commit();
+	}
+	
+	sreg |= 0x80;
+	in_irq = 0;
+}
+
+void host_run(unsigned long us)
+{
+	unsigned long t = host_us + us;
+	
+	while(host_us < t)
+	{
+		host_us += (t - host_us > 100) ? 100 : t - host_us;
+		host_irq();
+	}
+}
+
+void host_ee_drain(void)
+{
+	while(ee_head != ee_tail)
+	{
+		host_run(HOST_EE_WRITE_US);
+	}
+}
+
+//Every SREG access counts as 1us of CPU time and is a point where IRQs may hit
+volatile uint8_t *host_sreg(void)
+{
+	host_us++;
+	host_irq();
+	return &sreg;
+}
+
+volatile uint8_t *host_eecr(void)
+{
+	ee_commit();
+	return &eecr;
+}
+
+volatile uint8_t *host_eedr(void)
+{
+	if(eecr & (1 << 0)) //EERE
+	{
+		eedr = host_eeprom[EEAR % HOST_EE_SIZE];
+		eecr &= ~(1 << 0);
+	}
+	return &eedr;
+}
+
+volatile uint8_t *host_twdr(void)
+{
+	host_us += HOST_TWI_BYTE_US;
+	host_twi_bytes++;
+	return &twdr;
+}
+
+//Every PORTD access sees the result of the previous write, so the LCD
+//bit-bang is decoded here: data bit on rising clock while CS is low
+volatile uint8_t *host_portd(void)
+{
+	uint8_t v = portd;
+	
+	if(v & LCD_CS)
+	{
+		lcd_bits = 0;
+	}
+	else if((v & LCD_CLOCK) && !(lcd_old & LCD_CLOCK))
+	{
+		lcd_byte = (lcd_byte << 1) | ((v & LCD_DATA) ? 1 : 0);
+		if(++lcd_bits == 8)
+		{
+			host_lcd_hash = (host_lcd_hash ^ lcd_byte ^ ((v & LCD_DC_A0) ? 0x100 : 0)) * 16777619UL;
+			host_lcd_bytes++;
+			host_us += host_lcd_byte_us;
+			host_irq();
+			lcd_bits = 0;
+		}
+	}
+	lcd_old = v;
+	
+	return &portd;
+}
+
+void cli(void)
+{
+	sreg &= 0x7F;
+}
+
+void sei(void)
+{
+	sreg |= 0x80;
+	host_irq();
+}
+
+void _delay_ms(double ms)
+{
+	host_run((unsigned long) (ms * 1000));
+}
+
+void _delay_us(double us)
+{
+	host_run((unsigned long) us);
+}
+
+void set_sleep_mode(int mode)
+{
+}
+
+void sleep_enable(void)
+{
+}
+
+void sleep_disable(void)
+{
+}
+
+//Idle until next timer tick
+void sleep_mode(void)
+{
+	host_run(next_t0 > host_us ? next_t0 - host_us : 1);
+}
+
+void sleep_cpu(void)
+{
+	sleep_mode();
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	return host_eeprom[(uintptr_t) p % HOST_EE_SIZE];
+}
+
+void eeprom_write_byte(uint8_t *p, uint8_t v)
+{
+	host_eeprom[(uintptr_t) p % HOST_EE_SIZE] = v;
+	host_ee_writes[(uintptr_t) p % HOST_EE_SIZE]++;
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t v)
+{
+	if(eeprom_read_byte(p) != v)
+	{
+		eeprom_write_byte(p, v);
+	}
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+	return eeprom_read_byte((const uint8_t*) p) | (eeprom_read_byte((const uint8_t*) p + 1) << 8);
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	size_t t1;
+	
+	for(t1 = 0; t1 < n; t1++)
+	{
+		((uint8_t*) dst)[t1] = eeprom_read_byte((const uint8_t*) src + t1);
+	}
+}
+
+int eeprom_is_ready(void)
+{
+	return 1;
+}
+
+void eeprom_busy_wait(void)
+{
+}
+
+//Same algorithms as avr-libc
+uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+	int t1;
+	
+	crc ^= a;
+	for(t1 = 0; t1 < 8; t1++)
+	{
+		crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+	int t1;
+	
+	crc ^= data;
+	for(t1 = 0; t1 < 8; t1++)
+	{
+		crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+	}
+	return crc;
+}
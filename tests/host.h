@@ -0,0 +1,30 @@
+//Host emulation of the ATmega328P parts Mini5.c uses: simulated time with
+//timer/ADC/EEPROM IRQs, EEPROM with per-cell write counters, TWI timing,
+//bytes sent to the LCD.
+//Tests compile the firmware with -Dmain=firmware_main and include it.
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+#define HOST_EE_SIZE 1024
+#define HOST_ADC_US 104   //ADC sample period (125kHz / 13)
+#define HOST_TWI_BYTE_US 23 //One TWI byte at 400kHz
+#define HOST_EE_WRITE_US 3400
+#define HOST_LCD_BYTE_US 15 //Bit-banged LCD byte at 16MHz, ~30 cycles per bit
+
+extern unsigned long host_us;                   //Simulated time
+extern uint8_t host_eeprom[HOST_EE_SIZE];
+extern unsigned long host_ee_writes[HOST_EE_SIZE]; //Program cycles per cell
+extern unsigned long host_twi_bytes;
+extern unsigned long host_lcd_bytes;            //Bytes clocked into the LCD
+extern uint32_t host_lcd_hash;                  //FNV-1a over LCD bytes and D/C line
+extern unsigned long host_lcd_byte_us;          //CPU time per LCD byte, 0 after host_reset()
+extern int (*host_adc)(int ch);                 //ADC source, default: no key, RX, no signal
+
+void host_reset(void);      //Time, IRQs and counters to 0, EEPROM erased (0xFF)
+void host_run(unsigned long us); //Let time pass, IRQs fire if enabled
+void host_ee_drain(void);   //Let time pass until EEPROM write queue is empty (IRQs on)
+int host_adc_default(int ch);
+
+#endif
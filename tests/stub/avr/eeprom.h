@@ -0,0 +1,11 @@
+//Host stand-in for <avr/eeprom.h>, backed by host_eeprom[] in host.c
+#include <stdint.h>
+#include <stddef.h>
+#define EEMEM
+uint8_t eeprom_read_byte(const uint8_t*);
+void eeprom_write_byte(uint8_t*, uint8_t);
+void eeprom_update_byte(uint8_t*, uint8_t);
+uint16_t eeprom_read_word(const uint16_t*);
+void eeprom_read_block(void*, const void*, size_t);
+int eeprom_is_ready(void);
+void eeprom_busy_wait(void);
@@ -0,0 +1,4 @@
+//Host stand-in for <avr/interrupt.h>, vectors are plain functions called by host.c
+#define ISR(v) void v(void); void v(void)
+void cli(void);
+void sei(void);
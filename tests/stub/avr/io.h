@@ -0,0 +1,81 @@
+//Host stand-in for <avr/io.h>, registers with side effects are routed thru host.c
+#include <stdint.h>
+
+#define R(x) extern volatile uint8_t x;
+R(PORTB) R(PORTC) R(DDRB) R(DDRC) R(DDRD) R(PINB) R(PINC) R(PIND)
+R(PCICR) R(PCMSK0) R(PCMSK1) R(PCMSK2) R(PCIFR)
+R(TCCR0A) R(TCCR0B) R(OCR0A) R(TIMSK0) R(TCNT0) R(TIFR0)
+R(TCCR1A) R(TCCR1B) R(OCR1AH) R(OCR1AL) R(TIMSK1)
+R(TCCR2A) R(TCCR2B) R(OCR2A) R(TIMSK2) R(TCNT2)
+R(ADMUX) R(ADCSRA) R(ADCSRB) R(ADCL) R(ADCH) R(DIDR0) R(ACSR)
+R(TWSR) R(TWBR) R(TWCR)
+#undef R
+extern volatile uint16_t EEAR;
+
+volatile uint8_t *host_sreg(void);
+volatile uint8_t *host_eecr(void);
+volatile uint8_t *host_eedr(void);
+volatile uint8_t *host_twdr(void);
+volatile uint8_t *host_portd(void);
+#define SREG (*host_sreg())
+#define EECR (*host_eecr())
+#define EEDR (*host_eedr())
+#define TWDR (*host_twdr())
+#define PORTD (*host_portd())
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PCIE0 0
+#define PCIE1 1
+#define PCINT0 0
+#define PCINT1 1
+#define PCIF0 0
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM01 1
+#define OCIE0A 1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define OCIE1A 1
+#define CS22 2
+#define WGM21 1
+#define OCIE2A 1
+#define REFS0 6
+#define ADLAR 5
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define TWINT 7
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN 2
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define _BV(b) (1 << (b))
+#define bit_is_set(r, b) ((r) & _BV(b))
+#define bit_is_clear(r, b) (!((r) & _BV(b)))
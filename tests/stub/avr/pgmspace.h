@@ -0,0 +1,19 @@
+//Host stand-in for <avr/pgmspace.h>, flash is ordinary memory
+#include <stdint.h>
+#include <string.h>
+//Flash data gets its own section as on the AVR, so make size can tell it from RAM data
+#define PROGMEM __attribute__((section(".progmem.data")))
+#define PGM_P const char *
+#define PSTR(s) (__extension__({static const char __c[] PROGMEM = (s); &__c[0];}))
+//Reads through memcpy() so flash data may be of any type, like on the AVR
+static inline uint8_t host_pgm_byte(const void *p) { uint8_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint16_t host_pgm_word(const void *p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t host_pgm_dword(const void *p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void *host_pgm_ptr(const void *p) { void *v; memcpy(&v, p, sizeof(v)); return v; }
+#define pgm_read_byte(p) host_pgm_byte(p)
+#define pgm_read_word(p) host_pgm_word(p)
+#define pgm_read_dword(p) host_pgm_dword(p)
+#define pgm_read_ptr(p) host_pgm_ptr(p)
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define memcpy_P memcpy
@@ -0,0 +1,8 @@
+//Host stand-in for <avr/sleep.h>, sleeping lets simulated time run to the next IRQ
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_STANDBY 6
+void set_sleep_mode(int);
+void sleep_mode(void);
+void sleep_enable(void);
+void sleep_disable(void);
+void sleep_cpu(void);
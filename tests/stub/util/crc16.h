@@ -0,0 +1,4 @@
+//Host stand-in for <util/crc16.h>
+#include <stdint.h>
+uint16_t _crc16_update(uint16_t, uint8_t);
+uint8_t _crc_ibutton_update(uint8_t, uint8_t);
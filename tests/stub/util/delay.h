@@ -0,0 +1,3 @@
+//Host stand-in for <util/delay.h>, delays advance simulated time
+void _delay_ms(double);
+void _delay_us(double);
@@ -0,0 +1,103 @@
+//Config block on emulated EEPROM: migration from old layout, torn writes
+//fall back to copy B, defaults only if both copies are bad, also with
+//two saves in the write queue
+#include <stdio.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+int fails = 0;
+
+void check(int cond, const char *msg)
+{
+	if(!cond)
+	{
+		printf("%s\n", msg);
+		fails++;
+	}
+}
+
+//Power cycle: RAM copy is lost, config block is read back
+void reboot(void)
+{
+	memset(&cfg, 0, sizeof(cfg));
+	thresh = -1;
+	config_load();
+	host_ee_drain();
+}
+
+int main(void)
+{
+	int t1, k, v, old_ok, new_ok, torn = 0, torn2 = 0;
+	long f = 14123400, lo, lo_old;
+	
+	host_reset();
+	sei();
+	
+	//Old layout: 20m VFO A at 64 + 16 (MSB first), threshold 5 at 138
+	for(t1 = 0; t1 < 4; t1++)
+	{
+		host_eeprom[OFF_FREQ_DATA + 16 + t1] = f >> (24 - 8 * t1);
+	}
+	host_eeprom[138] = 5;
+	reboot();
+	check(cfg.f[2][0] == f && thresh == 5 && cfg.f[0][0] == 3650000, "Old layout not migrated");
+	
+	//Setting survives reboot, migration is not repeated
+	v = 9;
+	CONFIG_SAVE(thresh, v);
+	host_ee_drain();
+	reboot();
+	check(thresh == 9 && cfg.f[2][0] == f, "Setting lost");
+	
+	//Power lost while a setting is written: old or new value, never defaults or old layout
+	for(k = 0; k < 200; k++)
+	{
+		v = (thresh == 9) ? 10 : 9;
+		CONFIG_SAVE(thresh, v);
+		host_run((k % 12) * HOST_EE_WRITE_US + 100);
+		if(ee_head != ee_tail)
+		{
+			torn++;
+		}
+		ee_tail = ee_head; //Queue is lost
+		reboot();
+		old_ok = (thresh == 19 - v);
+		new_ok = (thresh == v);
+		check((old_ok || new_ok) && cfg.f[2][0] == f, "Torn write not recovered");
+	}
+	
+	//Two settings saved before the queue drains (if_autolo, menus), then power lost
+	for(k = 0; k < 400; k++)
+	{
+		v = (thresh == 9) ? 10 : 9;
+		lo_old = f_lo[0];
+		lo = f_lo[0] + 100 - (k & 2) * 100;
+		CONFIG_SAVE(thresh, v);
+		CONFIG_SAVE(f_lo[0], lo);
+		host_run((k % 40) * HOST_EE_WRITE_US / 2 + 100);
+		if(ee_head != ee_tail)
+		{
+			torn2++;
+		}
+		ee_tail = ee_head;
+		reboot();
+		old_ok = (thresh == 19 - v || thresh == v) && (f_lo[0] == lo || f_lo[0] == lo_old);
+		if(!old_ok || cfg.f[2][0] != f)
+		{
+			check(0, "Torn write of two saves not recovered");
+			break; //Later rounds start from defaults
+		}
+	}
+	
+	//Both copies bad: defaults, not old layout
+	host_eeprom[OFF_CONFIG + 5] ^= 0x55;
+	host_eeprom[OFF_CONFIG_B + 5] ^= 0x55;
+	reboot();
+	check(thresh == 5 && cfg.f[2][0] == f_vfo[2][0], "No defaults with both copies bad");
+	
+	printf("%d torn writes recovered, %d with two saves pending\n", torn, torn2);
+	printf("%s\n", fails ? "FAIL" : "OK");
+	
+	return fails != 0;
+}
@@ -0,0 +1,150 @@
+//State log wear on emulated EEPROM: bytes written per save, per-cell
+//program cycles, recovery after reboot and after a torn write
+#include <stdio.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+#define SAVES 20000
+
+unsigned long rnd_state = 1;
+
+unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 16) % n;
+}
+
+unsigned long ee_total(void)
+{
+	unsigned long n = 0;
+	int t1;
+	
+	for(t1 = 0; t1 < HOST_EE_SIZE; t1++)
+	{
+		n += host_ee_writes[t1];
+	}
+	return n;
+}
+
+//Power cycle: RAM state is lost, log is read back
+int reboot(int band, int vfo, int sb, long f)
+{
+	log_pos = -1;
+	memset(log_rec, 0, sizeof(log_rec));
+	cur_band = cur_vfo = sideband = -1;
+	f_vfo[band][vfo] = 0;
+	
+	if(!load_current_operation())
+	{
+		return 0;
+	}
+	return cur_band == band && cur_vfo == vfo && sideband == sb && f_vfo[band][vfo] == f;
+}
+
+int main(void)
+{
+	int t1, band = 2, vfo = 0, sb = 1, fails = 0;
+	int band0, vfo0, sb0, ok;
+	long f = 14200000, f0;
+	unsigned long w, wmax = 0, wmin = SAVES, bytes, saves = 0;
+	
+	host_reset();
+	sei();
+	
+	for(t1 = 0; t1 < SAVES; t1++)
+	{
+		//Mostly tuning, sometimes VFO, sideband or band change
+		switch(rnd(100))
+		{
+			case 0: band = rnd(MAXBANDS);
+			        f = c_freq[band];
+			        sb = std_sideband[band];
+			        break;
+			case 1: 
+			case 2: vfo ^= 1;
+			        break;
+			case 3: sb ^= 1;
+			        break;
+			default: f += ((long) rnd(201) - 100) * 10;
+		}
+		if(!is_band_freq(f, band))
+		{
+			f = c_freq[band];
+		}
+		
+		store_current_operation(band, vfo, sb, f);
+		host_ee_drain();
+		saves++;
+		
+		if(!(t1 % 97) && !reboot(band, vfo, sb, f))
+		{
+			printf("Save %d not recovered\n", t1);
+			fails++;
+		}
+	}
+	
+	bytes = ee_total();
+	for(t1 = OFF_STATE_LOG; t1 < OFF_STATE_LOG + LOG_SLOTS * LOG_REC; t1++)
+	{
+		w = host_ee_writes[t1];
+		wmax = (w > wmax) ? w : wmax;
+		wmin = (w < wmin) ? w : wmin;
+	}
+	
+	printf("%lu saves, %.2f bytes written per save (full record %d)\n", saves, (double) bytes / saves, LOG_REC);
+	printf("Program cycles per log cell: min %lu, max %lu (fixed locations: %lu)\n", wmin, wmax, saves);
+	
+	//Headers and checksums are written with every record, one slot in LOG_SLOTS per save
+	if(bytes >= saves * LOG_REC || wmax > saves / LOG_SLOTS + 1)
+	{
+		fails++;
+	}
+	
+	//Power lost after k bytes of a save: either old or new state comes back
+	for(t1 = 0; t1 < 200; t1++)
+	{
+		int k = rnd(LOG_REC + 1);
+		
+		band0 = band;
+		vfo0 = vfo;
+		sb0 = sb;
+		f0 = f;
+		if(rnd(4))
+		{
+			f += 10 + rnd(100) * 10;
+		}
+		else
+		{
+			band = rnd(MAXBANDS);
+			f = c_freq[band] + rnd(100) * 10;
+		}
+		if(!is_band_freq(f, band))
+		{
+			f = c_freq[band];
+		}
+		
+		store_current_operation(band, vfo, sb, f);
+		host_run(k * HOST_EE_WRITE_US - HOST_EE_WRITE_US / 2);
+		ee_tail = ee_head; //Queue is lost
+		
+		ok = reboot(band, vfo, sb, f);
+		if(!ok)
+		{
+			ok = reboot(band0, vfo0, sb0, f0);
+			band = band0;
+			vfo = vfo0;
+			sb = sb0;
+			f = f0;
+		}
+		if(!ok)
+		{
+			printf("Torn write (%d bytes) not recovered\n", k);
+			fails++;
+		}
+	}
+	
+	printf("%s\n", fails ? "FAIL" : "OK");
+	
+	return fails != 0;
+}
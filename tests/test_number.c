@@ -0,0 +1,165 @@
+//Streaming lcd_putnumber_r() against the former int2asc() + lcd_putstring(),
+//compared by the bytes clocked into the LCD
+#include <stdio.h>
+#include <stdlib.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+//int2asc() as it was before the streaming converter
+int int2asc(long num, int dec, char *buf, int buflen)
+{
+    int i, c, xp = 0, neg = 0;
+    long n, dd = 1E09;
+
+    if(!num)
+	{
+	    *buf++ = '0';
+		*buf = 0;
+		return 1;
+	}
+
+    if(num < 0)
+    {
+     	neg = 1;
+	    n = num * -1;
+    }
+    else
+    {
+	    n = num;
+    }
+
+    //Fill buffer with \0
+    for(i = 0; i < 12; i++)
+    {
+	    *(buf + i) = 0;
+    }
+
+    c = 9; //Max. number of displayable digits
+    while(dd)
+    {
+	    i = n / dd;
+	    n = n - i * dd;
+
+	    *(buf + 9 - c + xp) = i + 48;
+	    dd /= 10;
+	    if(c == dec && dec)
+	    {
+	        *(buf + 9 - c + ++xp) = '.';
+	    }
+	    c--;
+    }
+
+    //Search for 1st char different from '0'
+    i = 0;
+    while(*(buf + i) == 48)
+    {
+	    *(buf + i++) = 32;
+    }
+
+    //Add minus-sign if neccessary
+    if(neg)
+    {
+	    *(buf + --i) = '-';
+    }
+
+    //Eleminate leading spaces
+    c = 0;
+    while(*(buf + i))
+    {
+	    *(buf + c++) = *(buf + i++);
+    }
+    *(buf + c) = 0;
+
+	return c;
+}
+
+//Expected text: int2asc() output, "0" in front of a leading point (".5" is now "0.5"),
+//right aligned in width chars
+int expected(long num, int dec, int width, char *s)
+{
+	char buf[16], tmp[24];
+	int len = int2asc(num, dec, buf + 1, 15);
+	char *p = buf + 1;
+
+	if(p[0] == '.' || (p[0] == '-' && p[1] == '.'))
+	{
+		p = tmp;
+		sprintf(tmp, (buf[1] == '-') ? "-0%s" : "0%s", buf + 1 + (buf[1] == '-'));
+		len++;
+	}
+	sprintf(s, "%*s", width, p);
+
+	return (width > len) ? width : len;
+}
+
+//Glyphs of text s as lcd_putstring() drew them
+void draw_text(int col, int row, const char *s)
+{
+	while(*s)
+	{
+		lcd_putchar(col, row, *(s++), WHITE, backcolor, 1, 1);
+		col += FONTWIDTH;
+	}
+}
+
+int check(long num, int dec, int width)
+{
+	char s[24];
+	int len_ref, len;
+	uint32_t hash_ref;
+
+	len_ref = expected(num, dec, width, s);
+	host_reset();
+	draw_text(0, 0, s);
+	hash_ref = host_lcd_hash;
+
+	host_reset();
+	len = lcd_putnumber_r(0, 0, num, dec, width, WHITE, backcolor, 1, 1);
+
+	if(len != len_ref || host_lcd_hash != hash_ref)
+	{
+		printf("%ld dec %d width %d: expected \"%s\" (%d chars), got %d chars%s\n",
+		       num, dec, width, s, len_ref, len, (host_lcd_hash != hash_ref) ? ", other glyphs" : "");
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	static const int decs[] = {-1, 0, 1, 2, 3};
+	static const int widths[] = {0, 4, 8};
+	long v, p;
+	int d, w, t1, cases = 0, fails = 0;
+
+	for(d = 0; d < 5; d++)
+	{
+		for(w = 0; w < 3; w++)
+		{
+			for(v = -2000; v <= 2000; v++)
+			{
+				fails += check(v, decs[d], widths[w]);
+				cases++;
+			}
+			for(p = 10; p <= 1000000000L; p *= 10)
+			{
+				fails += check(p - 1, decs[d], widths[w]) + check(p, decs[d], widths[w]) + check(-(p - 1), decs[d], widths[w]);
+				cases += 3;
+			}
+			for(t1 = 0; t1 < 2000; t1++)
+			{
+				v = ((long) rand() << 15 ^ rand()) % 1000000000L;
+				fails += check(v, decs[d], widths[w]) + check(-v, decs[d], widths[w]);
+				cases += 2;
+			}
+		}
+	}
+	fails += check(2147483647L, 1, 0); //Largest long, 10 digits
+	cases++;
+
+	printf("%d numbers, %d differ\n", cases, fails);
+	printf("%s\n", fails ? "FAIL" : "OK");
+
+	return fails != 0;
+}
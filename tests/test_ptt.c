@@ -0,0 +1,113 @@
+//PTT-to-RF latency: time from PTT line going high until the TX image
+//(XIT offset) is in the VFO multisynth, on the main screen and with PTT
+//pressed while a scan started from the menu is stepping. LCD bytes cost
+//CPU time here, so a redraw in front of the changeover shows up
+#include <stdio.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+#define RUNS 50
+#define MAX_MAIN_US 40000 //Debounce + longest task ahead of task_ptt (SENS display)
+#define MAX_SCAN_US 70000 //Debounce + scan display refresh under way, no redraw after it
+#define SCAN_START_US 1500000 //Scan screen is drawn by then
+
+unsigned long t_ptt, t_rf;
+int ptt_line;
+
+int ptt_adc(int ch)
+{
+	if(ch != 7)
+	{
+		return host_adc_default(ch);
+	}
+
+	if(!ptt_line && t_ptt && host_us >= t_ptt)
+	{
+		ptt_line = 1;
+	}
+	if(ptt_line && !t_rf && !memcmp(si5351_shadow[1], vfo_regs[1], 8))
+	{
+		t_rf = host_us;
+	}
+
+	return ptt_line ? 1023 : 0;
+}
+
+//Back to RX on main screen
+void release(void)
+{
+	ptt_line = 0;
+	t_ptt = 0;
+	while(ptt_tx || ptt_event || ui_screen != UI_MAIN)
+	{
+		sched_run();
+	}
+}
+
+//PTT goes high delay_us from now, returns us until TX image is written
+unsigned long measure(unsigned long delay_us)
+{
+	unsigned long t_end;
+
+	t_rf = 0;
+	t_ptt = host_us + delay_us;
+	t_end = t_ptt + 5000000;
+	while(!t_rf && host_us < t_end)
+	{
+		sched_run();
+	}
+
+	return t_rf ? t_rf - t_ptt : t_end - t_ptt;
+}
+
+int report(const char *name, int scan, unsigned long start, unsigned long limit)
+{
+	int t1;
+	unsigned long us, sum = 0, max = 0;
+
+	for(t1 = 0; t1 < RUNS; t1++)
+	{
+		if(scan) //SCAN / f0..f1 from the menu
+		{
+			ui_screen = UI_MENU1;
+			ui_menu = 5;
+			ui_pos = 0;
+			key_put(2);
+		}
+		us = measure(start + t1 * 7919);
+		sum += us;
+		if(us > max)
+		{
+			max = us;
+		}
+		release();
+	}
+	printf("%-12s PTT to RF avg. %4lu us, max. %4lu us (limit %lu us)\n", name, sum / RUNS, max, limit);
+
+	return max > limit;
+}
+
+int main(void)
+{
+	int fails = 0;
+
+	host_reset();
+	host_lcd_byte_us = HOST_LCD_BYTE_US;
+	host_adc = ptt_adc;
+	sei();
+
+	cur_band = 2;
+	cur_vfo = 0;
+	sideband = 1;
+	f_vfo[2][0] = 14200000;
+	xit = 1000; //TX image differs from RX image
+	set_vfo(f_vfo[cur_band][cur_vfo] + f_lo[sideband]);
+
+	fails += report("main screen", 0, 1000000, MAX_MAIN_US);
+	fails += report("menu scan", 1, SCAN_START_US, MAX_SCAN_US);
+
+	printf("%s\n", fails ? "FAIL" : "OK");
+
+	return fails != 0;
+}
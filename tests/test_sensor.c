@@ -0,0 +1,98 @@
+//Fixed-point sensor conversion against the former double formulas,
+//all 1024 ADC codes
+#include <stdio.h>
+#include <stdlib.h>
+#include "../Mini5.c" //main() is renamed to firmware_main() by Makefile
+#undef main
+#include "host.h"
+
+//get_pa_temp() before fixed-point conversion
+int pa_temp_double(int adc)
+{
+	double ux = (double) (5 * adc) / 1023;
+	double rx = 1000 / (5 / ux - 1);
+	double temp = (rx - 815) / 8.81;
+	
+	return (int) temp;
+}
+
+//Supply voltage (0.1V) before fixed-point conversion
+int voltage_double(int adc)
+{
+	double v1 = (double) adc * 5 / 1024 * 6 * 10;
+	
+	return (int) v1;
+}
+
+//TX power (0.1W) curve tx_pwr_tab[] was made from: P ~ U^2, 10W at ADC2 = 960
+double tx_power_double(int adc)
+{
+	return 100.0 * adc * adc / (960.0 * 960.0);
+}
+
+int main(void)
+{
+	int adc, t, v, p, px, px_old = 0, p_old = 0;
+	int err, t_err = 0, v_err = 0, fails = 0;
+	double p_err = 0, e;
+	
+	host_reset();
+	
+	for(adc = 0; adc < 1024; adc++)
+	{
+		//PA temperature: at most 1 degree C off between -40 and 150 C
+		t = pa_temp_double(adc);
+		if(t >= -40 && t <= 150)
+		{
+			err = abs(sensor_lookup(pa_temp_tab, adc) / 16 - t);
+			if(err > t_err)
+			{
+				t_err = err;
+			}
+			if(err > 1)
+			{
+				printf("PA temp ADC %d: %d, double %d\n", adc, sensor_lookup(pa_temp_tab, adc) / 16, t);
+				fails++;
+			}
+		}
+		
+		//Voltage: exact
+		adc_val[6] = adc;
+		v = get_voltage();
+		if(v != voltage_double(adc))
+		{
+			printf("Voltage ADC %d: %d, double %d\n", adc, v, voltage_double(adc));
+			v_err++;
+			fails++;
+		}
+		
+		//TX power: at most 0.2W off curve, monotonic, on meter scale
+		adc_val[2] = adc;
+		p = get_tx_power();
+		e = fabs(p - tx_power_double(adc));
+		if(e > p_err)
+		{
+			p_err = e;
+		}
+		px = tx_power2px(p);
+		if(e > 2 || p < p_old || px < px_old || px > 127)
+		{
+			printf("TX power ADC %d: %d (double %.1f), %dpx\n", adc, p, tx_power_double(adc), px);
+			fails++;
+		}
+		p_old = p;
+		px_old = px;
+	}
+	
+	adc_val[2] = 960;
+	if(tx_power2px(get_tx_power()) != 112) //10W mark of "0 2  4  6  8 10W"
+	{
+		printf("10W at %dpx\n", tx_power2px(get_tx_power()));
+		fails++;
+	}
+	
+	printf("PA temp max. error %d C, voltage mismatches %d, TX power max. error %.2f W\n", t_err, v_err, p_err / 10);
+	printf("%s\n", fails ? "FAIL" : "OK");
+	
+	return fails != 0;
+}